@@ -0,0 +1,486 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+#define SORT_ENABLE_STATS // comparison, swap and move counts
+#include "sort.h"
+
+//Peak memory tracking: a sort context whose alloc/free hooks keep a size
+//header in front of each block. The context is only active on the calling
+//thread, so worker threads of the parallel sorts (which use malloc) and the
+//thread pool's own bookkeeping are not counted.
+typedef union { size_t size; max_align_t align; } bench_header;
+static size_t bench_current_bytes = 0;
+static size_t bench_peak_bytes = 0;
+
+static void* bench_alloc(size_t size, void* user_data) {
+    (void)user_data;
+    bench_header* h = (bench_header*)malloc(sizeof(bench_header) + size);
+    if (!h) return NULL;
+    h->size = size;
+    bench_current_bytes += size;
+    if (bench_current_bytes > bench_peak_bytes) bench_peak_bytes = bench_current_bytes;
+    return h + 1;
+}
+
+static void bench_free(void* p, void* user_data) {
+    (void)user_data;
+    if (!p) return;
+    bench_header* h = (bench_header*)p - 1;
+    bench_current_bytes -= h->size;
+    free(h);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+#else
+static double now_seconds(void) {
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+#endif
+
+//Comparators on the key stored at the start of each element. Elements of
+//4 bytes hold a 32-bit key, larger elements a 64-bit key followed by padding.
+static int compare_key32(const void* a, const void* b) {
+    uint32_t x, y;
+    memcpy(&x, a, sizeof(x));
+    memcpy(&y, b, sizeof(y));
+    return (x > y) - (x < y);
+}
+
+static int compare_key64(const void* a, const void* b) {
+    uint64_t x, y;
+    memcpy(&x, a, sizeof(x));
+    memcpy(&y, b, sizeof(y));
+    return (x > y) - (x < y);
+}
+
+//Algorithms
+typedef enum { KIND_GENERIC, KIND_INT, KIND_INT64 } algo_kind;
+
+typedef struct {
+    const char* name;
+    algo_kind kind;
+    void (*generic)(void*, size_t, size_t, compare_func_t);
+    void (*int_sort)(int*, size_t);
+    void (*int64_sort)(int64_t*, size_t);
+    bool quadratic;    // O(n^2): only run up to --max-quadratic elements
+} algorithm;
+
+static void parallel_sort_all_cores(void* base, size_t num, size_t size, compare_func_t cmp) {
+    parallelSort(base, num, size, cmp, 0);
+}
+
+static void parallel_merge_sort_all_cores(void* base, size_t num, size_t size, compare_func_t cmp) {
+    parallelMergeSort(base, num, size, cmp, 0);
+}
+
+static void indirect_sort(void* base, size_t num, size_t size, compare_func_t cmp) {
+    indirectSort(base, num, size, cmp, NULL);
+}
+
+static void auto_sort(void* base, size_t num, size_t size, compare_func_t cmp) {
+    autoSort(base, num, size, cmp, SORT_KEY_GENERIC);
+}
+
+static void auto_sort_int(int* arr, size_t num) {
+    autoSort(arr, num, sizeof(int), NULL, SORT_KEY_INT);
+}
+
+static void auto_sort_int64(int64_t* arr, size_t num) {
+    autoSort(arr, num, sizeof(int64_t), NULL, SORT_KEY_INT64);
+}
+
+static void parallel_radix_sort_int_all_cores(int* arr, size_t num) {
+    parallelRadixSortInt(arr, num, 0);
+}
+
+static void parallel_counting_sort_all_cores(int* arr, size_t num) {
+    parallelCountingSort(arr, num, 0);
+}
+
+static void parallel_bucket_sort_all_cores(int* arr, size_t num) {
+    parallelBucketSort(arr, num, 0);
+}
+
+static void parallel_radix_sort_int64_all_cores(int64_t* arr, size_t num) {
+    parallelRadixSortInt64(arr, num, 0);
+}
+
+#define GENERIC(name, fn, quadratic) { name, KIND_GENERIC, fn, NULL, NULL, quadratic }
+#define INT_SORT(name, fn) { name, KIND_INT, NULL, fn, NULL, false }
+#define INT64_SORT(name, fn) { name, KIND_INT64, NULL, NULL, fn, false }
+
+static const algorithm algorithms[] = {
+    GENERIC("bubbleSort", bubbleSort, true),
+    GENERIC("insertionSort", insertionSort, true),
+    GENERIC("selectionSort", selectionSort, true),
+    GENERIC("mergeSort", mergeSort, false),
+    GENERIC("quickSort", quickSort, false),
+    GENERIC("heapSort", heapSort, false),
+    GENERIC("shellSort", shellSort, false),
+    GENERIC("cocktailShakerSort", cocktailShakerSort, true),
+    GENERIC("combSort", combSort, false),
+    GENERIC("gnomeSort", gnomeSort, true),
+    GENERIC("oddEvenSort", oddEvenSort, true),
+    GENERIC("bitonicSort", bitonicSort, false),
+    GENERIC("cycleSort", cycleSort, true),
+    GENERIC("introSort", introSort, false),
+    GENERIC("timSort", timSort, false),
+    GENERIC("blockMergeSort", blockMergeSort, false),
+    GENERIC("parallelSort", parallel_sort_all_cores, false),
+    GENERIC("parallelMergeSort", parallel_merge_sort_all_cores, false),
+    GENERIC("indirectSort", indirect_sort, false),
+    GENERIC("autoSort", auto_sort, false),
+    INT_SORT("pigeonholeSort", pigeonholeSort),
+    INT_SORT("countingSort", countingSort),
+    INT_SORT("parallelCountingSort", parallel_counting_sort_all_cores),
+    INT_SORT("radixSort", radixSort),
+    INT_SORT("bucketSort", bucketSort),
+    INT_SORT("parallelBucketSort", parallel_bucket_sort_all_cores),
+    INT_SORT("quickSortInt", quickSortInt),
+    INT_SORT("mergeSortInt", mergeSortInt),
+    INT_SORT("heapSortInt", heapSortInt),
+    INT_SORT("bitonicSortInt", bitonicSortInt),
+    INT_SORT("parallelRadixSortInt", parallel_radix_sort_int_all_cores),
+    INT_SORT("autoSort:int", auto_sort_int),
+    INT64_SORT("quickSortInt64", quickSortInt64),
+    INT64_SORT("mergeSortInt64", mergeSortInt64),
+    INT64_SORT("radixSortInt64", radixSortInt64),
+    INT64_SORT("parallelRadixSortInt64", parallel_radix_sort_int64_all_cores),
+    INT64_SORT("autoSort:int64", auto_sort_int64),
+};
+static const size_t algorithm_count = sizeof(algorithms) / sizeof(algorithms[0]);
+
+//Input distributions
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static const char* const distributions[] = {
+    "random", "sorted", "reverse", "sawtooth", "few-unique", "zipf", "organ-pipe", "nearly-sorted"
+};
+static const size_t distribution_count = sizeof(distributions) / sizeof(distributions[0]);
+
+//Keys fit in 31 bits so the int-specific sorts see non-negative values
+static void generate_keys(uint64_t* keys, size_t n, const char* dist) {
+    const uint64_t key_mask = 0x7FFFFFFF;
+    if (strcmp(dist, "random") == 0) {
+        for (size_t i = 0; i < n; i++) keys[i] = next_random() & key_mask;
+    } else if (strcmp(dist, "sorted") == 0) {
+        for (size_t i = 0; i < n; i++) keys[i] = i & key_mask;
+    } else if (strcmp(dist, "reverse") == 0) {
+        for (size_t i = 0; i < n; i++) keys[i] = (n - i) & key_mask;
+    } else if (strcmp(dist, "sawtooth") == 0) {
+        size_t period = (size_t)sqrt((double)n) + 1;
+        for (size_t i = 0; i < n; i++) keys[i] = i % period;
+    } else if (strcmp(dist, "few-unique") == 0) {
+        for (size_t i = 0; i < n; i++) keys[i] = next_random() % 16;
+    } else if (strcmp(dist, "zipf") == 0) {
+        //Continuous approximation of Zipf (s = 1) over n ranks
+        double log_n = log((double)n + 1.0);
+        for (size_t i = 0; i < n; i++) {
+            double u = (double)(next_random() >> 11) * (1.0 / 9007199254740992.0);
+            keys[i] = ((uint64_t)exp(u * log_n) - 1) & key_mask;
+        }
+    } else if (strcmp(dist, "organ-pipe") == 0) {
+        for (size_t i = 0; i < n; i++) keys[i] = i < n / 2 ? i : n - i;
+    } else {
+        //nearly-sorted: sorted with 1% of the elements swapped at random
+        for (size_t i = 0; i < n; i++) keys[i] = i & key_mask;
+        for (size_t s = 0; s < n / 100 + 1 && n > 1; s++) {
+            size_t a = (size_t)(next_random() % n), b = (size_t)(next_random() % n);
+            uint64_t t = keys[a]; keys[a] = keys[b]; keys[b] = t;
+        }
+    }
+}
+
+static void build_elements(unsigned char* dst, const uint64_t* keys, size_t n, size_t elem_size) {
+    memset(dst, 0xA5, n * elem_size);
+    for (size_t i = 0; i < n; i++) {
+        if (elem_size == 4) {
+            uint32_t k = (uint32_t)keys[i];
+            memcpy(dst + i * elem_size, &k, sizeof(k));
+        } else {
+            memcpy(dst + i * elem_size, &keys[i], sizeof(keys[i]));
+        }
+    }
+}
+
+//Options
+typedef enum { FORMAT_TABLE, FORMAT_CSV, FORMAT_JSON } output_format;
+
+typedef struct {
+    size_t sizes[32];
+    size_t size_count;
+    size_t elem_sizes[8];
+    size_t elem_size_count;
+    const char* dist_filter;
+    const char* algo_filter;
+    size_t reps;
+    size_t max_quadratic;
+    size_t max_bytes;
+    output_format format;
+} options;
+
+static size_t parse_list(const char* s, size_t* out, size_t max) {
+    size_t count = 0;
+    while (*s && count < max) {
+        char* end;
+        double v = strtod(s, &end);  // accepts 1e6 style sizes
+        if (end == s) break;
+        out[count++] = (size_t)v;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return count;
+}
+
+static bool in_filter(const char* filter, const char* name) {
+    if (!filter) return true;
+    size_t len = strlen(name);
+    for (const char* p = filter; (p = strstr(p, name)) != NULL; p += len) {
+        bool starts = p == filter || p[-1] == ',';
+        bool ends = p[len] == '\0' || p[len] == ',';
+        if (starts && ends) return true;
+    }
+    return false;
+}
+
+static void usage(const char* prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  --sizes LIST       element counts, e.g. 16,1000,1e6,1e8 (default 16,1000,100000,1000000)\n");
+    printf("  --elem-sizes LIST  element sizes in bytes from 4,8,16,64,256 (default all)\n");
+    printf("  --dists LIST       distributions (default all):");
+    for (size_t i = 0; i < distribution_count; i++) printf(" %s", distributions[i]);
+    printf("\n  --algos LIST       algorithm names (default all)\n");
+    printf("  --reps N           timed repetitions, fastest is reported (default 3)\n");
+    printf("  --max-quadratic N  largest input for O(n^2) sorts (default 4096)\n");
+    printf("  --max-bytes N      largest input in bytes (default 1073741824)\n");
+    printf("  --format F         table, csv or json (default table)\n");
+    printf("  --seed N           random seed\n");
+}
+
+static bool parse_options(int argc, char** argv, options* opt) {
+    static const size_t default_sizes[] = {16, 1000, 100000, 1000000};
+    static const size_t default_elem_sizes[] = {4, 8, 16, 64, 256};
+    memcpy(opt->sizes, default_sizes, sizeof(default_sizes));
+    opt->size_count = sizeof(default_sizes) / sizeof(default_sizes[0]);
+    memcpy(opt->elem_sizes, default_elem_sizes, sizeof(default_elem_sizes));
+    opt->elem_size_count = sizeof(default_elem_sizes) / sizeof(default_elem_sizes[0]);
+    opt->dist_filter = NULL;
+    opt->algo_filter = NULL;
+    opt->reps = 3;
+    opt->max_quadratic = 4096;
+    opt->max_bytes = (size_t)1 << 30;
+    opt->format = FORMAT_TABLE;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            usage(argv[0]);
+            exit(0);
+        }
+        if (!val) {
+            fprintf(stderr, "Missing value for %s\n", arg);
+            return false;
+        }
+        i++;
+        if (strcmp(arg, "--sizes") == 0) {
+            opt->size_count = parse_list(val, opt->sizes, 32);
+        } else if (strcmp(arg, "--elem-sizes") == 0) {
+            opt->elem_size_count = parse_list(val, opt->elem_sizes, 8);
+            for (size_t e = 0; e < opt->elem_size_count; e++) {
+                if (opt->elem_sizes[e] != 4 && opt->elem_sizes[e] < 8) {
+                    fprintf(stderr, "Element sizes must be 4 or at least 8 bytes\n");
+                    return false;
+                }
+            }
+        } else if (strcmp(arg, "--dists") == 0) {
+            opt->dist_filter = val;
+        } else if (strcmp(arg, "--algos") == 0) {
+            opt->algo_filter = val;
+        } else if (strcmp(arg, "--reps") == 0) {
+            opt->reps = (size_t)strtoull(val, NULL, 10);
+            if (opt->reps == 0) opt->reps = 1;
+        } else if (strcmp(arg, "--max-quadratic") == 0) {
+            opt->max_quadratic = (size_t)strtod(val, NULL);
+        } else if (strcmp(arg, "--max-bytes") == 0) {
+            opt->max_bytes = (size_t)strtod(val, NULL);
+        } else if (strcmp(arg, "--seed") == 0) {
+            rng_state = strtoull(val, NULL, 10) | 1;
+        } else if (strcmp(arg, "--format") == 0) {
+            if (strcmp(val, "table") == 0) opt->format = FORMAT_TABLE;
+            else if (strcmp(val, "csv") == 0) opt->format = FORMAT_CSV;
+            else if (strcmp(val, "json") == 0) opt->format = FORMAT_JSON;
+            else {
+                fprintf(stderr, "Unknown format: %s\n", val);
+                return false;
+            }
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", arg);
+            return false;
+        }
+    }
+    return true;
+}
+
+//Running one measurement
+typedef struct {
+    double ns_per_element;
+    unsigned long long comparisons;
+    unsigned long long swaps;
+    unsigned long long moves;
+    size_t peak_bytes;
+    bool has_counts;
+    bool sorted;
+} result;
+
+static void run_once(const algorithm* algo, unsigned char* data, size_t n, size_t elem_size) {
+    compare_func_t cmp = elem_size == 4 ? compare_key32 : compare_key64;
+    switch (algo->kind) {
+        case KIND_GENERIC: algo->generic(data, n, elem_size, cmp); break;
+        case KIND_INT: algo->int_sort((int*)data, n); break;
+        case KIND_INT64: algo->int64_sort((int64_t*)data, n); break;
+    }
+}
+
+static bool check_sorted(const unsigned char* data, size_t n, size_t elem_size) {
+    compare_func_t cmp = elem_size == 4 ? compare_key32 : compare_key64;
+    for (size_t i = 1; i < n; i++) {
+        if (cmp(data + (i - 1) * elem_size, data + i * elem_size) > 0) return false;
+    }
+    return true;
+}
+
+static result measure(const algorithm* algo, const unsigned char* input, unsigned char* work, size_t n, size_t elem_size, size_t reps) {
+    result r;
+    double best = 0;
+    size_t peak = 0;
+    for (size_t rep = 0; rep < reps; rep++) {
+        memcpy(work, input, n * elem_size);
+        size_t baseline = bench_current_bytes;
+        bench_peak_bytes = baseline;
+        double start = now_seconds();
+        run_once(algo, work, n, elem_size);
+        double elapsed = now_seconds() - start;
+        if (rep == 0 || elapsed < best) best = elapsed;
+        if (bench_peak_bytes - baseline > peak) peak = bench_peak_bytes - baseline;
+    }
+    const sort_stats_t* stats = sortLastStats();
+    r.ns_per_element = n ? best * 1e9 / (double)n : 0;
+    r.comparisons = stats->comparisons;
+    r.swaps = stats->swaps;
+    r.moves = stats->moves;
+    r.peak_bytes = peak;
+    //The typed sorts compare and move values inline and are not counted
+    r.has_counts = algo->kind == KIND_GENERIC;
+    r.sorted = check_sorted(work, n, elem_size);
+    return r;
+}
+
+static void print_header(output_format format) {
+    if (format == FORMAT_CSV) {
+        printf("algorithm,distribution,elem_size,n,ns_per_element,comparisons,swaps,moves,peak_extra_bytes,sorted\n");
+    } else if (format == FORMAT_JSON) {
+        printf("[\n");
+    } else {
+        printf("%-24s %-14s %5s %11s %12s %14s %14s %14s %14s %s\n", "algorithm", "distribution", "bytes", "n", "ns/elem", "comparisons", "swaps", "moves", "peak extra", "ok");
+    }
+}
+
+static void format_count(char* buf, size_t len, bool valid, unsigned long long value, output_format format) {
+    if (valid) snprintf(buf, len, "%llu", value);
+    else strcpy(buf, format == FORMAT_JSON ? "null" : "");
+}
+
+static void print_result(output_format format, bool first, const char* algo, const char* dist, size_t elem_size, size_t n, const result* r) {
+    char cmps[32], swaps[32], moves[32];
+    format_count(cmps, sizeof(cmps), r->has_counts, r->comparisons, format);
+    format_count(swaps, sizeof(swaps), r->has_counts, r->swaps, format);
+    format_count(moves, sizeof(moves), r->has_counts, r->moves, format);
+    if (format == FORMAT_CSV) {
+        printf("%s,%s,%zu,%zu,%.3f,%s,%s,%s,%zu,%d\n", algo, dist, elem_size, n, r->ns_per_element, cmps, swaps, moves, r->peak_bytes, r->sorted);
+    } else if (format == FORMAT_JSON) {
+        printf("%s  {\"algorithm\": \"%s\", \"distribution\": \"%s\", \"elem_size\": %zu, \"n\": %zu, "
+               "\"ns_per_element\": %.3f, \"comparisons\": %s, \"swaps\": %s, \"moves\": %s, \"peak_extra_bytes\": %zu, \"sorted\": %s}",
+               first ? "" : ",\n", algo, dist, elem_size, n, r->ns_per_element, cmps, swaps, moves, r->peak_bytes, r->sorted ? "true" : "false");
+    } else {
+        printf("%-24s %-14s %5zu %11zu %12.2f %14s %14s %14s %14zu %s\n", algo, dist, elem_size, n, r->ns_per_element, cmps, swaps, moves, r->peak_bytes, r->sorted ? "yes" : "NO");
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    options opt;
+    if (!parse_options(argc, argv, &opt)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    sort_context_t bench_context;
+    sortContextInit(&bench_context, NULL, 0);
+    bench_context.alloc = bench_alloc;
+    bench_context.free = bench_free;
+    sortUseContext(&bench_context);
+
+    print_header(opt.format);
+    bool first = true;
+    int failures = 0;
+    for (size_t si = 0; si < opt.size_count; si++) {
+        size_t n = opt.sizes[si];
+        uint64_t* keys = (uint64_t*)malloc((n ? n : 1) * sizeof(uint64_t));
+        if (!keys) {
+            fprintf(stderr, "Not enough memory for n = %zu\n", n);
+            continue;
+        }
+        for (size_t di = 0; di < distribution_count; di++) {
+            const char* dist = distributions[di];
+            if (!in_filter(opt.dist_filter, dist)) continue;
+            generate_keys(keys, n, dist);
+            for (size_t ei = 0; ei < opt.elem_size_count; ei++) {
+                size_t elem_size = opt.elem_sizes[ei];
+                if (n > opt.max_bytes / elem_size) continue;
+                unsigned char* input = (unsigned char*)malloc((n ? n : 1) * elem_size);
+                unsigned char* work = (unsigned char*)malloc((n ? n : 1) * elem_size);
+                if (!input || !work) {
+                    fprintf(stderr, "Not enough memory for n = %zu, elem_size = %zu\n", n, elem_size);
+                    free(input);
+                    free(work);
+                    continue;
+                }
+                build_elements(input, keys, n, elem_size);
+                for (size_t ai = 0; ai < algorithm_count; ai++) {
+                    const algorithm* algo = &algorithms[ai];
+                    if (!in_filter(opt.algo_filter, algo->name)) continue;
+                    if (algo->kind == KIND_INT && elem_size != sizeof(int)) continue;
+                    if (algo->kind == KIND_INT64 && elem_size != sizeof(int64_t)) continue;
+                    if (algo->quadratic && n > opt.max_quadratic) continue;
+                    result r = measure(algo, input, work, n, elem_size, opt.reps);
+                    if (!r.sorted) failures++;
+                    print_result(opt.format, first, algo->name, dist, elem_size, n, &r);
+                    first = false;
+                }
+                free(input);
+                free(work);
+            }
+        }
+        free(keys);
+    }
+    if (opt.format == FORMAT_JSON) printf("\n]\n");
+    if (failures) fprintf(stderr, "%d runs produced unsorted output\n", failures);
+    return failures ? 1 : 0;
+}
@@ -7,12 +7,322 @@
 #include <string.h> // For memcpy
 #include <assert.h> // For assert()
 #include <limits.h> // For INT_MAX/INT_MIN
+#include <stdint.h> // For fixed-width integer types
+#include <stdio.h> // For FILE and file I/O
+#include <math.h> // For HUGE_VALF
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h> // For sysconf, unlink and close
+#endif
+
+//externalSort uses mkstemp, fdopen and fseeko where the POSIX names are
+//visible; strict ISO modes (-std=c11) hide them unless POSIX.1-2008 is
+//requested before the first system include. -pthread alone only brings in
+//_POSIX_C_SOURCE 199506L, which declares neither mkstemp nor fseeko
+#if (defined(__unix__) || defined(__APPLE__)) && (!defined(__STRICT_ANSI__) || (defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200809L) || (defined(_XOPEN_SOURCE) && _XOPEN_SOURCE >= 700))
+#define SORT_HAS_POSIX_IO 1
+#include <sys/types.h> // For off_t
+#endif
+
+//Parallel sorts use POSIX threads where available; define SORT_NO_THREADS to
+//build them as sequential fallbacks instead
+#if !defined(SORT_NO_THREADS) && (defined(__unix__) || defined(__APPLE__) || defined(__MINGW32__))
+#define SORT_HAS_THREADS 1
+#include <pthread.h> // For pthread_create, mutexes and condition variables
+#endif
+
+//SIMD kernels are built for x86 with GCC/Clang target attributes and chosen
+//at run time; define SORT_NO_SIMD to leave them out
+#if !defined(SORT_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SORT_HAS_AVX2 1
+#include <immintrin.h> // For AVX2 intrinsics
+#endif
 
 typedef int (*compare_func_t)(const void* a, const void* b);
 
+#if defined(__cplusplus)
+#define SORT_THREAD_LOCAL thread_local
+#elif defined(_MSC_VER)
+#define SORT_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define SORT_THREAD_LOCAL __thread
+#else
+#define SORT_THREAD_LOCAL _Thread_local
+#endif
+
+//Status codes
+//The void sorts report failures through sortLastStatus(); a sort that
+//cannot get its temporary space leaves the array a permutation of the input
+//but not necessarily sorted. Sorts with an in-place fallback use it instead.
+typedef enum {
+    SORT_OK = 0,
+    SORT_ERROR_NO_MEMORY = -1, // temporary space could not be allocated
+    SORT_ERROR_IO = -2,        // reading or writing a file failed
+    SORT_ERROR_INVALID = -3    // unknown algorithm or unusable argument
+} sort_status_t;
+
+//Sort context
+//A sort_context_t supplies the temporary space of every sort run while it
+//is active on a thread (sortUseContext, or for one call sortWithContext).
+//Requests are served first from the caller's arena, a bump allocator that
+//rolls back as blocks are released, then from the alloc/free pair. With
+//alloc == NULL a sort never touches the heap: when the arena is too small
+//it fails with SORT_ERROR_NO_MEMORY. sortWorkspaceSize() reports the arena
+//size an algorithm needs. Without an active context sorts use malloc/free.
+//Worker threads of the parallel sorts allocate from the heap.
+typedef struct {
+    void* (*alloc)(size_t bytes, void* user_data);
+    void (*free)(void* ptr, void* user_data);
+    void* user_data;
+    unsigned char* arena;
+    size_t arena_size;
+    size_t arena_used;
+    size_t arena_top;  // offset of the newest arena block, SIZE_MAX if none
+    size_t arena_peak; // high-water mark of arena_used
+} sort_context_t;
+
+#ifndef SORT_ARENA_ALIGN
+#define SORT_ARENA_ALIGN 16
+#endif
+//Arena bytes taken by one request of the given size (header + padding)
+#define SORT_ARENA_BLOCK(bytes) (SORT_ARENA_ALIGN + (((bytes) + SORT_ARENA_ALIGN - 1) & ~(size_t)(SORT_ARENA_ALIGN - 1)))
+
+static SORT_THREAD_LOCAL sort_context_t* sort_context_active;
+static SORT_THREAD_LOCAL sort_status_t sort_last_status;
+static SORT_THREAD_LOCAL size_t sort_call_nesting;
+
+static void* sort_systemAlloc(size_t bytes, void* user_data) {
+    (void)user_data;
+    return malloc(bytes);
+}
+
+static void sort_systemFree(void* ptr, void* user_data) {
+    (void)user_data;
+    free(ptr);
+}
+
+//Sets up ctx with an optional arena (NULL/0 for none) and malloc/free as
+//the fallback allocator
+void sortContextInit(sort_context_t* ctx, void* arena, size_t arena_size) {
+    assert(ctx != NULL && "Context cannot be NULL");
+    ctx->alloc = sort_systemAlloc;
+    ctx->free = sort_systemFree;
+    ctx->user_data = NULL;
+    ctx->arena = NULL;
+    ctx->arena_size = 0;
+    if (arena && arena_size > 0) {
+        uintptr_t addr = (uintptr_t)arena;
+        size_t pad = (size_t)((SORT_ARENA_ALIGN - addr % SORT_ARENA_ALIGN) % SORT_ARENA_ALIGN);
+        if (arena_size > pad) {
+            ctx->arena = (unsigned char*)arena + pad;
+            ctx->arena_size = (arena_size - pad) & ~(size_t)(SORT_ARENA_ALIGN - 1);
+        }
+    }
+    ctx->arena_used = 0;
+    ctx->arena_top = SIZE_MAX;
+    ctx->arena_peak = 0;
+}
+
+//Makes ctx the active context of this thread (NULL for malloc/free) and
+//returns the previous one
+sort_context_t* sortUseContext(sort_context_t* ctx) {
+    sort_context_t* prev = sort_context_active;
+    sort_context_active = ctx;
+    return prev;
+}
+
+//Status of the last sort call made on this thread
+sort_status_t sortLastStatus(void) {
+    return sort_last_status;
+}
+
+static void sort_fail(sort_status_t status) {
+    if (sort_last_status == SORT_OK) sort_last_status = status;
+}
+
+//Arena block layout: [offset of the previous block | freed flag | data...]
+static void* sort_arenaAlloc(sort_context_t* ctx, size_t bytes) {
+    if (bytes > ctx->arena_size || SORT_ARENA_BLOCK(bytes) > ctx->arena_size - ctx->arena_used) return NULL;
+    size_t* header = (size_t*)(ctx->arena + ctx->arena_used);
+    header[0] = ctx->arena_top;
+    header[1] = 0;
+    ctx->arena_top = ctx->arena_used;
+    ctx->arena_used += SORT_ARENA_BLOCK(bytes);
+    if (ctx->arena_used > ctx->arena_peak) ctx->arena_peak = ctx->arena_used;
+    return (unsigned char*)header + SORT_ARENA_ALIGN;
+}
+
+//Marks the block free and pops every free block from the top of the arena
+static void sort_arenaFree(sort_context_t* ctx, void* ptr) {
+    size_t* header = (size_t*)((unsigned char*)ptr - SORT_ARENA_ALIGN);
+    header[1] = 1;
+    while (ctx->arena_top != SIZE_MAX) {
+        size_t* top = (size_t*)(ctx->arena + ctx->arena_top);
+        if (!top[1]) break;
+        ctx->arena_used = ctx->arena_top;
+        ctx->arena_top = top[0];
+    }
+}
+
+//Statistics
+//Define SORT_ENABLE_STATS before including sort.h to count, per public sort
+//call, comparator calls, swaps, element moves, temporary allocations, the
+//deepest partition recursion and the wall time. Counters live in
+//thread-local storage; nested public calls (quickSort -> introSort) are
+//folded into the outermost one. When a call finishes its totals are
+//available from sortLastStats() on the same thread and are passed to the
+//callback set with sortSetStatsCallback(). Without SORT_ENABLE_STATS all of
+//this compiles away.
+#ifdef SORT_ENABLE_STATS
+#include <time.h> // For clock_gettime / clock
+
+typedef struct {
+    const char* algorithm;              // outermost public function called
+    size_t num;                         // element count passed to it
+    unsigned long long comparisons;     // comparator calls
+    unsigned long long swaps;           // element swaps
+    unsigned long long moves;           // single-element copies (shifts, merges)
+    unsigned long long allocations;     // temporary buffers requested
+    unsigned long long allocated_bytes; // bytes requested for them
+    size_t max_depth;                   // deepest partition recursion
+    double seconds;                     // wall time of the call
+} sort_stats_t;
+
+typedef void (*sort_stats_callback_t)(const sort_stats_t* stats, void* user_data);
+
+static SORT_THREAD_LOCAL sort_stats_t sort_stats_current;
+static SORT_THREAD_LOCAL sort_stats_t sort_stats_last;
+static SORT_THREAD_LOCAL size_t sort_stats_depth;
+static SORT_THREAD_LOCAL double sort_stats_start;
+static sort_stats_callback_t sort_stats_callback = NULL;
+static void* sort_stats_user_data = NULL;
+
+static double sort_statsNow(void) {
+#if defined(__unix__) || defined(__APPLE__)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+static void sort_statsBegin(const char* algorithm, size_t num) {
+    memset(&sort_stats_current, 0, sizeof(sort_stats_current));
+    sort_stats_current.algorithm = algorithm;
+    sort_stats_current.num = num;
+    sort_stats_depth = 0;
+    sort_stats_start = sort_statsNow();
+}
+
+static void sort_statsEnd(void) {
+    sort_stats_current.seconds = sort_statsNow() - sort_stats_start;
+    sort_stats_last = sort_stats_current;
+    if (sort_stats_callback) sort_stats_callback(&sort_stats_last, sort_stats_user_data);
+}
+
+#ifdef SORT_HAS_THREADS
+//Adds counters gathered on another thread (parallel sort workers)
+static void sort_statsMerge(sort_stats_t* into, const sort_stats_t* from) {
+    into->comparisons += from->comparisons;
+    into->swaps += from->swaps;
+    into->moves += from->moves;
+    into->allocations += from->allocations;
+    into->allocated_bytes += from->allocated_bytes;
+    if (from->max_depth > into->max_depth) into->max_depth = from->max_depth;
+}
+#endif
+
+static void sort_statsEnter(void) {
+    if (++sort_stats_depth > sort_stats_current.max_depth) sort_stats_current.max_depth = sort_stats_depth;
+}
+
+//Statistics of the last completed sort call on this thread
+const sort_stats_t* sortLastStats(void) {
+    return &sort_stats_last;
+}
+
+//Calls callback(stats, user_data) after every sort call on any thread;
+//NULL disables it. Set it before sorting starts.
+void sortSetStatsCallback(sort_stats_callback_t callback, void* user_data) {
+    sort_stats_callback = callback;
+    sort_stats_user_data = user_data;
+}
+
+#define SORT_STATS_BEGIN(name, num) sort_statsBegin(name, num)
+#define SORT_STATS_END() sort_statsEnd()
+#define SORT_CMP(cmp, a, b) (sort_stats_current.comparisons++, (cmp)(a, b))
+#define SORT_STATS_SWAPS(n) (sort_stats_current.swaps += (n))
+#define SORT_STATS_MOVES(n) (sort_stats_current.moves += (n))
+#define SORT_STATS_ENTER() sort_statsEnter()
+#define SORT_STATS_LEAVE() (sort_stats_depth--)
+#define SORT_STATS_ALLOC(bytes) (sort_stats_current.allocations++, sort_stats_current.allocated_bytes += (bytes))
+#else
+#define SORT_STATS_BEGIN(name, num) ((void)0)
+#define SORT_STATS_END() ((void)0)
+#define SORT_CMP(cmp, a, b) (cmp)(a, b)
+#define SORT_STATS_SWAPS(n) ((void)0)
+#define SORT_STATS_MOVES(n) ((void)0)
+#define SORT_STATS_ENTER() ((void)0)
+#define SORT_STATS_LEAVE() ((void)0)
+#define SORT_STATS_ALLOC(bytes) ((void)0)
+#endif
+
+//Every public sort is bracketed by SORT_CALL_BEGIN/SORT_CALL_END; only the
+//outermost call resets the status and records statistics
+static void sort_callBegin(const char* algorithm, size_t num) {
+    if (sort_call_nesting++ > 0) return;
+    sort_last_status = SORT_OK;
+    SORT_STATS_BEGIN(algorithm, num);
+    (void)algorithm;
+    (void)num;
+}
+
+static void sort_callEnd(void) {
+    if (--sort_call_nesting > 0) return;
+    SORT_STATS_END();
+}
+
+#define SORT_CALL_BEGIN(name, num) sort_callBegin(name, num)
+#define SORT_CALL_END() sort_callEnd()
+
+//Temporary space for the sorts, drawn from the active context
+static void* sort_alloc(size_t bytes) {
+    SORT_STATS_ALLOC(bytes);
+    sort_context_t* ctx = sort_context_active;
+    if (!ctx) return malloc(bytes);
+    void* p = sort_arenaAlloc(ctx, bytes);
+    if (!p && ctx->alloc) p = ctx->alloc(bytes, ctx->user_data);
+    return p;
+}
+
+static void* sort_allocZeroed(size_t count, size_t bytes) {
+    if (bytes && count > SIZE_MAX / bytes) return NULL;
+    void* p = sort_alloc(count * bytes);
+    if (p) memset(p, 0, count * bytes);
+    return p;
+}
+
+static void sort_release(void* ptr) {
+    if (!ptr) return;
+    sort_context_t* ctx = sort_context_active;
+    if (!ctx) {
+        free(ptr);
+        return;
+    }
+    uintptr_t p = (uintptr_t)ptr, a = (uintptr_t)ctx->arena;
+    if (ctx->arena && p >= a && p < a + ctx->arena_size) sort_arenaFree(ctx, ptr);
+    else if (ctx->free) ctx->free(ptr, ctx->user_data);
+}
+
+#define SORT_MALLOC(bytes) sort_alloc(bytes)
+#define SORT_CALLOC(count, bytes) sort_allocZeroed(count, bytes)
+#define SORT_FREE(ptr) sort_release(ptr)
+
 //Utility Functions
 static void swap_bytes(void* a, void* b, size_t size) {
     if (a == NULL || b == NULL || size == 0) return;
+    SORT_STATS_SWAPS(1);
     unsigned char temp[size];
     memcpy(temp, a, size);
     memcpy(a, b, size);
@@ -32,48 +342,54 @@ int compare_ints(const void* a, const void* b) {
 void bubbleSort(void* base, size_t num, size_t size, compare_func_t cmp) {
     assert(base != NULL && "Array cannot be NULL");
     assert(cmp != NULL && "Comparison function cannot be NULL");
-    if (num <= 1) return;
+    SORT_CALL_BEGIN("bubbleSort", num);
+    if (num <= 1) { SORT_CALL_END(); return; }
     unsigned char* arr = (unsigned char*)base;
     for (size_t i = 0; i < num - 1; i++) {
         bool swapped = false;
         for (size_t j = 0; j < num - i - 1; j++) {
-            if (cmp(arr + j * size, arr + (j + 1) * size) > 0) {
+            if (SORT_CMP(cmp, arr + j * size, arr + (j + 1) * size) > 0) {
                 swap_bytes(arr + j * size, arr + (j + 1) * size, size);
                 swapped = true;
             }
         }
         if (!swapped) break;
     }
+    SORT_CALL_END();
 }
 
 //2. Insertion Sort
 void insertionSort(void* base, size_t num, size_t size, compare_func_t cmp) {
     assert(base != NULL && "Array cannot be NULL");
     assert(cmp != NULL && "Comparison function cannot be NULL");
-    if (num <= 1) return;
+    SORT_CALL_BEGIN("insertionSort", num);
+    if (num <= 1) { SORT_CALL_END(); return; }
     unsigned char* arr = (unsigned char*)base;
     for (size_t i = 1; i < num; i++) {
         unsigned char key[size];
         memcpy(key, arr + i * size, size);
         long j = i - 1;
-        while (j >= 0 && cmp(arr + j * size, key) > 0) {
+        while (j >= 0 && SORT_CMP(cmp, arr + j * size, key) > 0) {
             memcpy(arr + (j + 1) * size, arr + j * size, size);
+            SORT_STATS_MOVES(1);
             j--;
         }
         memcpy(arr + (j + 1) * size, key, size);
     }
+    SORT_CALL_END();
 }
 
 //3. Selection Sort
 void selectionSort(void* base, size_t num, size_t size, compare_func_t cmp) {
     assert(base != NULL && "Array cannot be NULL");
     assert(cmp != NULL && "Comparison function cannot be NULL");
-    if (num <= 1) return;
+    SORT_CALL_BEGIN("selectionSort", num);
+    if (num <= 1) { SORT_CALL_END(); return; }
     unsigned char* arr = (unsigned char*)base;
     for (size_t i = 0; i < num - 1; i++) {
         size_t min_idx = i;
         for (size_t j = i + 1; j < num; j++) {
-            if (cmp(arr + j * size, arr + min_idx * size) < 0) {
+            if (SORT_CMP(cmp, arr + j * size, arr + min_idx * size) < 0) {
                 min_idx = j;
             }
         }
@@ -81,82 +397,31 @@ void selectionSort(void* base, size_t num, size_t size, compare_func_t cmp) {
             swap_bytes(arr + min_idx * size, arr + i * size, size);
         }
     }
+    SORT_CALL_END();
 }
 
 //4. Merge Sort
-static void merge(void* base, size_t l, size_t m, size_t r, size_t size, compare_func_t cmp) {
-    size_t n1 = m - l + 1;
-    size_t n2 = r - m;
-    unsigned char* arr = (unsigned char*)base;
-    void* L = malloc(n1 * size);
-    void* R = malloc(n2 * size);
-    if (!L || !R) {
-        if (L) free(L);
-        if (R) free(R);
-        return;
-    }
-    memcpy(L, arr + l * size, n1 * size);
-    memcpy(R, arr + (m + 1) * size, n2 * size);
-    size_t i = 0, j = 0, k = l;
-    while (i < n1 && j < n2) {
-        if (cmp((unsigned char*)L + i * size, (unsigned char*)R + j * size) <= 0) {
-            memcpy(arr + k++ * size, (unsigned char*)L + i++ * size, size);
-        } else {
-            memcpy(arr + k++ * size, (unsigned char*)R + j++ * size, size);
-        }
-    }
-    while (i < n1) memcpy(arr + k++ * size, (unsigned char*)L + i++ * size, size);
-    while (j < n2) memcpy(arr + k++ * size, (unsigned char*)R + j++ * size, size);
-    free(L); free(R);
-}
-static void mergeSortHelper(void* base, size_t l, size_t r, size_t size, compare_func_t cmp) {
-    if (l < r) {
-        size_t m = l + (r - l) / 2;
-        mergeSortHelper(base, l, m, size, cmp);
-        mergeSortHelper(base, m + 1, r, size, cmp);
-        merge(base, l, m, r, size, cmp);
-    }
-}
+//Implemented on top of the adaptive run-merging engine (see 19. Tim Sort)
+void timSort(void* base, size_t num, size_t size, compare_func_t cmp);
 void mergeSort(void* base, size_t num, size_t size, compare_func_t cmp) {
     assert(base != NULL && "Array cannot be NULL");
     assert(cmp != NULL && "Comparison function cannot be NULL");
-    if (num <= 1) return;
-    mergeSortHelper(base, 0, num - 1, size, cmp);
+    SORT_CALL_BEGIN("mergeSort", num);
+    if (num <= 1) { SORT_CALL_END(); return; }
+    timSort(base, num, size, cmp);
+    SORT_CALL_END();
 }
 
 //5. Quick Sort
-static size_t partition(void* base, size_t low, size_t high, size_t size, compare_func_t cmp) {
-    unsigned char* arr = (unsigned char*)base;
-    void* pivot = malloc(size);
-    if (!pivot) return high;
-    memcpy(pivot, arr + high * size, size);
-    size_t i = low;
-    for (size_t j = low; j < high; j++) {
-        if (cmp(arr + j * size, pivot) < 0) {
-            swap_bytes(arr + i * size, arr + j * size, size);
-            i++;
-        }
-    }
-    swap_bytes(arr + i * size, arr + high * size, size);
-    free(pivot);
-    return i;
-}
-static void quickSortHelper(void* base, long low, long high, size_t size, compare_func_t cmp) {
-    if (low < high) {
-        size_t pi = partition(base, low, high, size, cmp);
-        if ((long)pi > low) {
-            quickSortHelper(base, low, pi - 1, size, cmp);
-        }
-        if ((long)pi < high) {
-            quickSortHelper(base, pi + 1, high, size, cmp);
-        }
-    }
-}
+//Implemented on top of the introsort engine (see 18. Intro Sort)
+void introSort(void* base, size_t num, size_t size, compare_func_t cmp);
 void quickSort(void* base, size_t num, size_t size, compare_func_t cmp) {
     assert(base != NULL && "Array cannot be NULL");
     assert(cmp != NULL && "Comparison function cannot be NULL");
-    if (num <= 1) return;
-    quickSortHelper(base, 0, num - 1, size, cmp);
+    SORT_CALL_BEGIN("quickSort", num);
+    if (num <= 1) { SORT_CALL_END(); return; }
+    introSort(base, num, size, cmp);
+    SORT_CALL_END();
 }
 
 //6. Heap Sort
@@ -165,8 +430,8 @@ static void heapify(void* base, size_t n, size_t i, size_t size, compare_func_t
     size_t largest = i;
     size_t l = 2 * i + 1;
     size_t r = 2 * i + 2;
-    if (l < n && cmp(arr + l * size, arr + largest * size) > 0) largest = l;
-    if (r < n && cmp(arr + r * size, arr + largest * size) > 0) largest = r;
+    if (l < n && SORT_CMP(cmp, arr + l * size, arr + largest * size) > 0) largest = l;
+    if (r < n && SORT_CMP(cmp, arr + r * size, arr + largest * size) > 0) largest = r;
     if (largest != i) {
         swap_bytes(arr + i * size, arr + largest * size, size);
         heapify(base, n, largest, size, cmp);
@@ -175,48 +440,52 @@ static void heapify(void* base, size_t n, size_t i, size_t size, compare_func_t
 void heapSort(void* base, size_t num, size_t size, compare_func_t cmp) {
     assert(base != NULL && "Array cannot be NULL");
     assert(cmp != NULL && "Comparison function cannot be NULL");
-    if (num <= 1) return;
+    SORT_CALL_BEGIN("heapSort", num);
+    if (num <= 1) { SORT_CALL_END(); return; }
     for (long i = num / 2 - 1; i >= 0; i--) heapify(base, num, i, size, cmp);
     for (long i = num - 1; i > 0; i--) {
         swap_bytes(base, (unsigned char*)base + i * size, size);
         heapify(base, i, 0, size, cmp);
     }
+    SORT_CALL_END();
 }
 
 //7. Shell Sort
 void shellSort(void* base, size_t num, size_t size, compare_func_t cmp) {
     assert(base != NULL && "Array cannot be NULL");
     assert(cmp != NULL && "Comparison function cannot be NULL");
-    if (num <= 1) return;
+    SORT_CALL_BEGIN("shellSort", num);
+    if (num <= 1) { SORT_CALL_END(); return; }
     unsigned char* arr = (unsigned char*)base;
+    unsigned char temp[size];
     for (size_t gap = num / 2; gap > 0; gap /= 2) {
         for (size_t i = gap; i < num; i++) {
-            void* temp = malloc(size);
-            if (!temp) return;
             memcpy(temp, arr + i * size, size);
             long j = i;
-            while (j >= gap && cmp(arr + (j - gap) * size, temp) > 0) {
+            while (j >= gap && SORT_CMP(cmp, arr + (j - gap) * size, temp) > 0) {
                 memcpy(arr + j * size, arr + (j - gap) * size, size);
+                SORT_STATS_MOVES(1);
                 j -= gap;
             }
             memcpy(arr + j * size, temp, size);
-            free(temp);
         }
     }
+    SORT_CALL_END();
 }
 
 //8. Cocktail Shaker Sort
 void cocktailShakerSort(void* base, size_t num, size_t size, compare_func_t cmp) {
     assert(base != NULL && "Array cannot be NULL");
     assert(cmp != NULL && "Comparison function cannot be NULL");
-    if (num <= 1) return;
+    SORT_CALL_BEGIN("cocktailShakerSort", num);
+    if (num <= 1) { SORT_CALL_END(); return; }
     unsigned char* arr = (unsigned char*)base;
     bool swapped = true;
     size_t start = 0, end = num - 1;
     while (swapped) {
         swapped = false;
         for (size_t i = start; i < end; i++) {
-            if (cmp(arr + i * size, arr + (i + 1) * size) > 0) {
+            if (SORT_CMP(cmp, arr + i * size, arr + (i + 1) * size) > 0) {
                 swap_bytes(arr + i * size, arr + (i + 1) * size, size);
                 swapped = true;
             }
@@ -225,20 +494,22 @@ void cocktailShakerSort(void* base, size_t num, size_t size, compare_func_t cmp)
         swapped = false;
         end--;
         for (long i = end - 1; i >= (long)start; i--) {
-            if (cmp(arr + i * size, arr + (i + 1) * size) > 0) {
+            if (SORT_CMP(cmp, arr + i * size, arr + (i + 1) * size) > 0) {
                 swap_bytes(arr + i * size, arr + (i + 1) * size, size);
                 swapped = true;
             }
         }
         start++;
     }
+    SORT_CALL_END();
 }
 
 //9. Comb Sort
 void combSort(void* base, size_t num, size_t size, compare_func_t cmp) {
     assert(base != NULL && "Array cannot be NULL");
     assert(cmp != NULL && "Comparison function cannot be NULL");
-    if (num <= 1) return;
+    SORT_CALL_BEGIN("combSort", num);
+    if (num <= 1) { SORT_CALL_END(); return; }
     unsigned char* arr = (unsigned char*)base;
     size_t gap = num;
     bool swapped = true;
@@ -247,106 +518,146 @@ void combSort(void* base, size_t num, size_t size, compare_func_t cmp) {
         if (gap < 1) gap = 1;
         swapped = false;
         for (size_t i = 0; i < num - gap; i++) {
-            if (cmp(arr + i * size, arr + (i + gap) * size) > 0) {
+            if (SORT_CMP(cmp, arr + i * size, arr + (i + gap) * size) > 0) {
                 swap_bytes(arr + i * size, arr + (i + gap) * size, size);
                 swapped = true;
             }
         }
     }
+    SORT_CALL_END();
 }
 
 //10. Gnome Sort
 void gnomeSort(void* base, size_t num, size_t size, compare_func_t cmp) {
     assert(base != NULL && "Array cannot be NULL");
     assert(cmp != NULL && "Comparison function cannot be NULL");
-    if (num <= 1) return;
+    SORT_CALL_BEGIN("gnomeSort", num);
+    if (num <= 1) { SORT_CALL_END(); return; }
     unsigned char* arr = (unsigned char*)base;
     size_t index = 0;
     while (index < num) {
         if (index == 0) index++;
-        if (cmp(arr + index * size, arr + (index - 1) * size) >= 0) {
+        if (SORT_CMP(cmp, arr + index * size, arr + (index - 1) * size) >= 0) {
             index++;
         } else {
             swap_bytes(arr + index * size, arr + (index - 1) * size, size);
             index--;
         }
     }
+    SORT_CALL_END();
 }
 
 //11. Odd-Even Sort (Brick Sort)
 void oddEvenSort(void* base, size_t num, size_t size, compare_func_t cmp) {
     assert(base != NULL && "Array cannot be NULL");
     assert(cmp != NULL && "Comparison function cannot be NULL");
-    if (num <= 1) return;
+    SORT_CALL_BEGIN("oddEvenSort", num);
+    if (num <= 1) { SORT_CALL_END(); return; }
     unsigned char* arr = (unsigned char*)base;
     bool isSorted = false;
     while (!isSorted) {
         isSorted = true;
         for (size_t i = 1; i < num - 1; i += 2) {
-            if (cmp(arr + i * size, arr + (i + 1) * size) > 0) {
+            if (SORT_CMP(cmp, arr + i * size, arr + (i + 1) * size) > 0) {
                 swap_bytes(arr + i * size, arr + (i + 1) * size, size);
                 isSorted = false;
             }
         }
         for (size_t i = 0; i < num - 1; i += 2) {
-            if (cmp(arr + i * size, arr + (i + 1) * size) > 0) {
+            if (SORT_CMP(cmp, arr + i * size, arr + (i + 1) * size) > 0) {
                 swap_bytes(arr + i * size, arr + (i + 1) * size, size);
                 isSorted = false;
             }
         }
     }
+    SORT_CALL_END();
 }
 
 //12. Bitonic Sort
-static void bitonicMerge(void* base, int low, int cnt, int dir, size_t size, compare_func_t cmp) {
-    if (cnt > 1) {
-        int k = cnt / 2;
-        unsigned char* arr = (unsigned char*)base;
-        for (int i = low; i < low + k; i++) {
-            if (dir == (cmp(arr + i * size, arr + (i + k) * size) > 0)) {
-                swap_bytes(arr + i * size, arr + (i + k) * size, size);
-            }
+//Iterative bitonic sorting network for any num. The input is treated as if
+//it were padded with +infinity up to the next power of two m. Every
+//compare-exchange puts the smaller value at the lower index (each merge
+//starts by comparing i with its mirror i ^ (k - 1) instead of reversing the
+//direction), so padding never moves and any exchange whose partner is >= num
+//can simply be skipped. Stages whose pair distance fits in a
+//SORT_BITONIC_BLOCK byte block are run block by block while it is in cache.
+#ifndef SORT_BITONIC_BLOCK
+#define SORT_BITONIC_BLOCK 16384
+#endif
+static size_t bitonicBlockElems(size_t size, size_t m) {
+    size_t b = 2;
+    while (b * 2 * size <= SORT_BITONIC_BLOCK && b * 2 <= m) b *= 2;
+    return b;
+}
+//First step of merge k over [lo, hi): compare i with its mirror in its k-block
+static void bitonicFlip(unsigned char* arr, size_t num, size_t lo, size_t hi, size_t k, size_t size, compare_func_t cmp) {
+    for (size_t b = lo; b < hi && b < num; b += k) {
+        size_t first = b + k > num ? b + k - num : 0;
+        for (size_t i = first; i < k / 2; i++) {
+            unsigned char* x = arr + (b + i) * size;
+            unsigned char* y = arr + (b + k - 1 - i) * size;
+            if (SORT_CMP(cmp, x, y) > 0) swap_bytes(x, y, size);
         }
-        bitonicMerge(base, low, k, dir, size, cmp);
-        bitonicMerge(base, low + k, k, dir, size, cmp);
     }
 }
-static void bitonicSortHelper(void* base, int low, int cnt, int dir, size_t size, compare_func_t cmp) {
-    if (cnt > 1) {
-        int k = cnt / 2;
-        bitonicSortHelper(base, low, k, 1, size, cmp);
-        bitonicSortHelper(base, low + k, k, 0, size, cmp);
-        bitonicMerge(base, low, cnt, dir, size, cmp);
+//Half-cleaner with distance j over [lo, hi)
+static void bitonicHalf(unsigned char* arr, size_t num, size_t lo, size_t hi, size_t j, size_t size, compare_func_t cmp) {
+    for (size_t b = lo; b < hi && b + j < num; b += 2 * j) {
+        size_t end = b + 2 * j <= num ? b + j : num - j;
+        for (size_t i = b; i < end; i++) {
+            unsigned char* x = arr + i * size;
+            unsigned char* y = arr + (i + j) * size;
+            if (SORT_CMP(cmp, x, y) > 0) swap_bytes(x, y, size);
+        }
     }
 }
 void bitonicSort(void* base, size_t num, size_t size, compare_func_t cmp) {
     assert(base != NULL && "Array cannot be NULL");
     assert(cmp != NULL && "Comparison function cannot be NULL");
-    assert((num > 0) && "Array size must be a power of 2");
-    bitonicSortHelper(base, 0, num, 1, size, cmp);
+    SORT_CALL_BEGIN("bitonicSort", num);
+    if (num <= 1) { SORT_CALL_END(); return; }
+    unsigned char* arr = (unsigned char*)base;
+    size_t m = 1;
+    while (m < num) m *= 2;
+    size_t block = bitonicBlockElems(size, m);
+    //Sort each block completely, then merge blocks; steps below block size
+    //are batched per block
+    for (size_t lo = 0; lo < num; lo += block) {
+        for (size_t k = 2; k <= block; k *= 2) {
+            bitonicFlip(arr, num, lo, lo + block, k, size, cmp);
+            for (size_t j = k / 4; j >= 1; j /= 2) bitonicHalf(arr, num, lo, lo + block, j, size, cmp);
+        }
+    }
+    for (size_t k = block * 2; k <= m; k *= 2) {
+        bitonicFlip(arr, num, 0, m, k, size, cmp);
+        for (size_t j = k / 4; j >= block; j /= 2) bitonicHalf(arr, num, 0, m, j, size, cmp);
+        for (size_t lo = 0; lo < num; lo += block) {
+            for (size_t j = block / 2; j >= 1; j /= 2) bitonicHalf(arr, num, lo, lo + block, j, size, cmp);
+        }
+    }
+    SORT_CALL_END();
 }
 
 //13. Cycle Sort
 void cycleSort(void* base, size_t num, size_t size, compare_func_t cmp) {
     assert(base != NULL && "Array cannot be NULL");
     assert(cmp != NULL && "Comparison function cannot be NULL");
-    if (num <= 1) return;
+    SORT_CALL_BEGIN("cycleSort", num);
+    if (num <= 1) { SORT_CALL_END(); return; }
     unsigned char* arr = (unsigned char*)base;
+    unsigned char item[size];
     for (size_t cycle_start = 0; cycle_start < num - 1; ++cycle_start) {
-        unsigned char* item = malloc(size);
-        if (!item) return;
         memcpy(item, arr + cycle_start * size, size);
         size_t pos = cycle_start;
         for (size_t i = cycle_start + 1; i < num; ++i) {
-            if (cmp(arr + i * size, item) < 0) {
+            if (SORT_CMP(cmp, arr + i * size, item) < 0) {
                 pos++;
             }
         }
         if (pos == cycle_start) {
-            free(item);
             continue;
         }
-        while (cmp(arr + pos * size, item) == 0) {
+        while (SORT_CMP(cmp, arr + pos * size, item) == 0) {
             pos++;
         }
         if (pos != cycle_start) {
@@ -355,130 +666,4737 @@ void cycleSort(void* base, size_t num, size_t size, compare_func_t cmp) {
         while (pos != cycle_start) {
             pos = cycle_start;
             for (size_t i = cycle_start + 1; i < num; ++i) {
-                if (cmp(arr + i * size, item) < 0) {
+                if (SORT_CMP(cmp, arr + i * size, item) < 0) {
                     pos++;
                 }
             }
-            while (cmp(arr + pos * size, item) == 0) {
+            while (SORT_CMP(cmp, arr + pos * size, item) == 0) {
                 pos++;
             }
-            if (cmp(item, arr + pos * size) != 0) {
+            if (SORT_CMP(cmp, item, arr + pos * size) != 0) {
                 swap_bytes(item, arr + pos * size, size);
             }
         }
-        free(item);
     }
+    SORT_CALL_END();
+}
+
+//18. Intro Sort
+//Quicksort with sampled pivots and three-way partitioning that falls back to
+//heapSort once the recursion gets too deep and finishes small ranges with
+//insertionSort. O(n log n) worst case, O(log n) stack, no heap allocations.
+#ifndef SORT_INSERTION_THRESHOLD
+#define SORT_INSERTION_THRESHOLD 16
+#endif
+#ifndef SORT_NINTHER_THRESHOLD
+#define SORT_NINTHER_THRESHOLD 128
+#endif
+static void swap_range(void* a, void* b, size_t bytes) {
+    unsigned char* pa = (unsigned char*)a;
+    unsigned char* pb = (unsigned char*)b;
+    unsigned char temp[256];
+    while (bytes > 0) {
+        size_t chunk = bytes < sizeof(temp) ? bytes : sizeof(temp);
+        memcpy(temp, pa, chunk);
+        memcpy(pa, pb, chunk);
+        memcpy(pb, temp, chunk);
+        pa += chunk; pb += chunk; bytes -= chunk;
+    }
+}
+static size_t sort_log2(size_t n) {
+    size_t r = 0;
+    while (n >>= 1) r++;
+    return r;
+}
+static size_t medianOf3(const unsigned char* arr, size_t a, size_t b, size_t c, size_t size, compare_func_t cmp) {
+    const void* pa = arr + a * size;
+    const void* pb = arr + b * size;
+    const void* pc = arr + c * size;
+    if (SORT_CMP(cmp, pa, pb) < 0) {
+        if (SORT_CMP(cmp, pb, pc) < 0) return b;
+        return SORT_CMP(cmp, pa, pc) < 0 ? c : a;
+    }
+    if (SORT_CMP(cmp, pa, pc) < 0) return a;
+    return SORT_CMP(cmp, pb, pc) < 0 ? c : b;
+}
+//Median of 3 for small ranges, Tukey's ninther for large ones
+static size_t choosePivot(const unsigned char* arr, size_t num, size_t size, compare_func_t cmp) {
+    size_t mid = num / 2, last = num - 1;
+    if (num > SORT_NINTHER_THRESHOLD) {
+        size_t step = num / 8;
+        size_t a = medianOf3(arr, 0, step, 2 * step, size, cmp);
+        size_t b = medianOf3(arr, mid - step, mid, mid + step, size, cmp);
+        size_t c = medianOf3(arr, last - 2 * step, last - step, last, size, cmp);
+        return medianOf3(arr, a, b, c, size, cmp);
+    }
+    return medianOf3(arr, 0, mid, last, size, cmp);
+}
+//Bentley-McIlroy three-way partition around arr[0]. Afterwards the array is
+//laid out as [ < pivot | == pivot | > pivot ]; the sizes of the outer two
+//regions are returned through lt_count and gt_count.
+static void partition(void* base, size_t num, size_t size, compare_func_t cmp, size_t* lt_count, size_t* gt_count) {
+    unsigned char* arr = (unsigned char*)base;
+    const unsigned char* pivot = arr;
+    size_t a = 1, b = 1, c = num - 1, d = num - 1;
+    for (;;) {
+        int r;
+        while (b <= c && (r = SORT_CMP(cmp, arr + b * size, pivot)) <= 0) {
+            if (r == 0) {
+                if (a != b) swap_bytes(arr + a * size, arr + b * size, size);
+                a++;
+            }
+            b++;
+        }
+        while (b <= c && (r = SORT_CMP(cmp, arr + c * size, pivot)) >= 0) {
+            if (r == 0) {
+                if (c != d) swap_bytes(arr + c * size, arr + d * size, size);
+                d--;
+            }
+            c--;
+        }
+        if (b > c) break;
+        swap_bytes(arr + b * size, arr + c * size, size);
+        b++; c--;
+    }
+    size_t s = a < b - a ? a : b - a;
+    swap_range(arr, arr + (b - s) * size, s * size);
+    SORT_STATS_SWAPS(s);
+    s = d - c < num - 1 - d ? d - c : num - 1 - d;
+    swap_range(arr + b * size, arr + (num - s) * size, s * size);
+    SORT_STATS_SWAPS(s);
+    *lt_count = b - a;
+    *gt_count = d - c;
+}
+static void introSortLoop(unsigned char* arr, size_t num, size_t size, compare_func_t cmp, size_t depth_limit) {
+    SORT_STATS_ENTER();
+    while (num > SORT_INSERTION_THRESHOLD) {
+        if (depth_limit == 0) {
+            heapSort(arr, num, size, cmp);
+            SORT_STATS_LEAVE();
+            return;
+        }
+        depth_limit--;
+        size_t p = choosePivot(arr, num, size, cmp);
+        if (p != 0) swap_bytes(arr, arr + p * size, size);
+        size_t lt, gt;
+        partition(arr, num, size, cmp, &lt, &gt);
+        unsigned char* right = arr + (num - gt) * size;
+        //Recurse into the smaller side and loop on the larger one to bound the stack
+        if (lt < gt) {
+            introSortLoop(arr, lt, size, cmp, depth_limit);
+            arr = right;
+            num = gt;
+        } else {
+            introSortLoop(right, gt, size, cmp, depth_limit);
+            num = lt;
+        }
+    }
+    insertionSort(arr, num, size, cmp);
+    SORT_STATS_LEAVE();
+}
+void introSort(void* base, size_t num, size_t size, compare_func_t cmp) {
+    assert(base != NULL && "Array cannot be NULL");
+    assert(cmp != NULL && "Comparison function cannot be NULL");
+    SORT_CALL_BEGIN("introSort", num);
+    if (num <= 1) { SORT_CALL_END(); return; }
+    introSortLoop((unsigned char*)base, num, size, cmp, 2 * sort_log2(num));
+    SORT_CALL_END();
+}
+
+//19. Tim Sort
+//Stable adaptive merge sort. Natural ascending and strictly descending runs
+//are detected (the latter reversed in place), short runs are extended with
+//binary insertion, and runs are merged with galloping. All merges share one
+//scratch buffer of num / 2 elements, so a sort makes at most one allocation
+//and already sorted input is handled in O(n).
+#define SORT_MIN_MERGE 64
+#define SORT_MIN_GALLOP 7
+#define SORT_MAX_RUNS 85
+typedef struct {
+    unsigned char* arr;
+    unsigned char* tmp;
+    size_t size;
+    compare_func_t cmp;
+    ptrdiff_t min_gallop;
+    size_t stack_size;
+    size_t run_base[SORT_MAX_RUNS];
+    size_t run_len[SORT_MAX_RUNS];
+} timsort_state;
+static size_t timMinRun(size_t n) {
+    size_t r = 0;
+    while (n >= SORT_MIN_MERGE) {
+        r |= n & 1;
+        n >>= 1;
+    }
+    return n + r;
+}
+static void reverseRange(unsigned char* arr, size_t num, size_t size) {
+    if (num < 2) return;
+    for (size_t i = 0, j = num - 1; i < j; i++, j--) {
+        swap_bytes(arr + i * size, arr + j * size, size);
+    }
+}
+//Length of the run starting at arr; descending runs are reversed so every
+//run comes back ascending. Descending must be strict to keep the sort stable.
+static size_t timCountRun(unsigned char* arr, size_t num, size_t size, compare_func_t cmp) {
+    if (num < 2) return num;
+    size_t i = 2;
+    if (SORT_CMP(cmp, arr + size, arr) < 0) {
+        while (i < num && SORT_CMP(cmp, arr + i * size, arr + (i - 1) * size) < 0) i++;
+        reverseRange(arr, i, size);
+    } else {
+        while (i < num && SORT_CMP(cmp, arr + i * size, arr + (i - 1) * size) >= 0) i++;
+    }
+    return i;
+}
+//Sorts arr[0, num) given that arr[0, start) is already sorted
+static void timBinaryInsertion(unsigned char* arr, size_t num, size_t start, size_t size, compare_func_t cmp) {
+    if (start == 0) start = 1;
+    unsigned char pivot[size];
+    for (; start < num; start++) {
+        memcpy(pivot, arr + start * size, size);
+        size_t left = 0, right = start;
+        while (left < right) {
+            size_t mid = left + (right - left) / 2;
+            if (SORT_CMP(cmp, pivot, arr + mid * size) < 0) right = mid;
+            else left = mid + 1;
+        }
+        memmove(arr + (left + 1) * size, arr + left * size, (start - left) * size);
+        memcpy(arr + left * size, pivot, size);
+        SORT_STATS_MOVES(start - left);
+    }
+}
+//Leftmost position k in run[0, len) with run[k - 1] < key <= run[k], searched outwards from hint
+static size_t gallopLeft(const void* key, const unsigned char* run, size_t len, size_t hint, size_t size, compare_func_t cmp) {
+    ptrdiff_t last_ofs = 0, ofs = 1, h = (ptrdiff_t)hint;
+    if (SORT_CMP(cmp, key, run + hint * size) > 0) {
+        ptrdiff_t max_ofs = (ptrdiff_t)len - h;
+        while (ofs < max_ofs && SORT_CMP(cmp, key, run + (h + ofs) * size) > 0) {
+            last_ofs = ofs;
+            ofs = (ofs << 1) + 1;
+        }
+        if (ofs > max_ofs) ofs = max_ofs;
+        last_ofs += h;
+        ofs += h;
+    } else {
+        ptrdiff_t max_ofs = h + 1;
+        while (ofs < max_ofs && SORT_CMP(cmp, key, run + (h - ofs) * size) <= 0) {
+            last_ofs = ofs;
+            ofs = (ofs << 1) + 1;
+        }
+        if (ofs > max_ofs) ofs = max_ofs;
+        ptrdiff_t t = last_ofs;
+        last_ofs = h - ofs;
+        ofs = h - t;
+    }
+    last_ofs++;
+    while (last_ofs < ofs) {
+        ptrdiff_t m = last_ofs + ((ofs - last_ofs) >> 1);
+        if (SORT_CMP(cmp, key, run + m * size) > 0) last_ofs = m + 1;
+        else ofs = m;
+    }
+    return (size_t)ofs;
+}
+//Rightmost position k in run[0, len) with run[k - 1] <= key < run[k], searched outwards from hint
+static size_t gallopRight(const void* key, const unsigned char* run, size_t len, size_t hint, size_t size, compare_func_t cmp) {
+    ptrdiff_t last_ofs = 0, ofs = 1, h = (ptrdiff_t)hint;
+    if (SORT_CMP(cmp, key, run + hint * size) < 0) {
+        ptrdiff_t max_ofs = h + 1;
+        while (ofs < max_ofs && SORT_CMP(cmp, key, run + (h - ofs) * size) < 0) {
+            last_ofs = ofs;
+            ofs = (ofs << 1) + 1;
+        }
+        if (ofs > max_ofs) ofs = max_ofs;
+        ptrdiff_t t = last_ofs;
+        last_ofs = h - ofs;
+        ofs = h - t;
+    } else {
+        ptrdiff_t max_ofs = (ptrdiff_t)len - h;
+        while (ofs < max_ofs && SORT_CMP(cmp, key, run + (h + ofs) * size) >= 0) {
+            last_ofs = ofs;
+            ofs = (ofs << 1) + 1;
+        }
+        if (ofs > max_ofs) ofs = max_ofs;
+        last_ofs += h;
+        ofs += h;
+    }
+    last_ofs++;
+    while (last_ofs < ofs) {
+        ptrdiff_t m = last_ofs + ((ofs - last_ofs) >> 1);
+        if (SORT_CMP(cmp, key, run + m * size) < 0) ofs = m;
+        else last_ofs = m + 1;
+    }
+    return (size_t)ofs;
+}
+//Merges adjacent runs a[base1, +len1) and a[base2, +len2) where len1 <= len2,
+//copying the first run into tmp and filling the array from the left
+static void timMergeLo(timsort_state* ts, size_t base1, size_t len1, size_t base2, size_t len2) {
+    unsigned char* a = ts->arr;
+    unsigned char* tmp = ts->tmp;
+    size_t size = ts->size;
+    compare_func_t cmp = ts->cmp;
+    memcpy(tmp, a + base1 * size, len1 * size);
+    size_t c1 = 0, c2 = base2, dest = base1;
+    memcpy(a + dest++ * size, a + c2++ * size, size);
+    if (--len2 == 0) {
+        memcpy(a + dest * size, tmp, len1 * size);
+        return;
+    }
+    if (len1 == 1) {
+        memmove(a + dest * size, a + c2 * size, len2 * size);
+        memcpy(a + (dest + len2) * size, tmp, size);
+        return;
+    }
+    ptrdiff_t min_gallop = ts->min_gallop;
+    for (;;) {
+        size_t count1 = 0, count2 = 0;
+        //Straight merge until one run starts winning consistently
+        do {
+            if (SORT_CMP(cmp, a + c2 * size, tmp + c1 * size) < 0) {
+                memcpy(a + dest++ * size, a + c2++ * size, size);
+                count2++; count1 = 0;
+                if (--len2 == 0) goto done;
+            } else {
+                memcpy(a + dest++ * size, tmp + c1++ * size, size);
+                count1++; count2 = 0;
+                if (--len1 == 1) goto done;
+            }
+        } while ((ptrdiff_t)(count1 | count2) < min_gallop);
+        //Galloping mode
+        do {
+            count1 = gallopRight(a + c2 * size, tmp + c1 * size, len1, 0, size, cmp);
+            if (count1 != 0) {
+                memcpy(a + dest * size, tmp + c1 * size, count1 * size);
+                dest += count1; c1 += count1; len1 -= count1;
+                if (len1 <= 1) goto done;
+            }
+            memcpy(a + dest++ * size, a + c2++ * size, size);
+            if (--len2 == 0) goto done;
+            count2 = gallopLeft(tmp + c1 * size, a + c2 * size, len2, 0, size, cmp);
+            if (count2 != 0) {
+                memmove(a + dest * size, a + c2 * size, count2 * size);
+                dest += count2; c2 += count2; len2 -= count2;
+                if (len2 == 0) goto done;
+            }
+            memcpy(a + dest++ * size, tmp + c1++ * size, size);
+            if (--len1 == 1) goto done;
+            min_gallop--;
+        } while (count1 >= SORT_MIN_GALLOP || count2 >= SORT_MIN_GALLOP);
+        if (min_gallop < 0) min_gallop = 0;
+        min_gallop += 2;
+    }
+done:
+    ts->min_gallop = min_gallop < 1 ? 1 : min_gallop;
+    if (len1 == 1) {
+        memmove(a + dest * size, a + c2 * size, len2 * size);
+        memcpy(a + (dest + len2) * size, tmp + c1 * size, size);
+    } else if (len1 > 0) {
+        memcpy(a + dest * size, tmp + c1 * size, len1 * size);
+    }
+}
+//Mirror of timMergeLo for len1 > len2: copies the second run into tmp and
+//fills the array from the right
+static void timMergeHi(timsort_state* ts, size_t base1, size_t len1, size_t base2, size_t len2) {
+    unsigned char* a = ts->arr;
+    unsigned char* tmp = ts->tmp;
+    size_t size = ts->size;
+    compare_func_t cmp = ts->cmp;
+    memcpy(tmp, a + base2 * size, len2 * size);
+    ptrdiff_t c1 = (ptrdiff_t)(base1 + len1) - 1, c2 = (ptrdiff_t)len2 - 1;
+    ptrdiff_t dest = (ptrdiff_t)(base2 + len2) - 1;
+    memcpy(a + dest-- * size, a + c1-- * size, size);
+    if (--len1 == 0) {
+        memcpy(a + (dest - (ptrdiff_t)len2 + 1) * size, tmp, len2 * size);
+        return;
+    }
+    if (len2 == 1) {
+        dest -= len1; c1 -= len1;
+        memmove(a + (dest + 1) * size, a + (c1 + 1) * size, len1 * size);
+        memcpy(a + dest * size, tmp + c2 * size, size);
+        return;
+    }
+    ptrdiff_t min_gallop = ts->min_gallop;
+    for (;;) {
+        size_t count1 = 0, count2 = 0;
+        do {
+            if (SORT_CMP(cmp, tmp + c2 * size, a + c1 * size) < 0) {
+                memcpy(a + dest-- * size, a + c1-- * size, size);
+                count1++; count2 = 0;
+                if (--len1 == 0) goto done;
+            } else {
+                memcpy(a + dest-- * size, tmp + c2-- * size, size);
+                count2++; count1 = 0;
+                if (--len2 == 1) goto done;
+            }
+        } while ((ptrdiff_t)(count1 | count2) < min_gallop);
+        do {
+            count1 = len1 - gallopRight(tmp + c2 * size, a + base1 * size, len1, len1 - 1, size, cmp);
+            if (count1 != 0) {
+                dest -= count1; c1 -= count1; len1 -= count1;
+                memmove(a + (dest + 1) * size, a + (c1 + 1) * size, count1 * size);
+                if (len1 == 0) goto done;
+            }
+            memcpy(a + dest-- * size, tmp + c2-- * size, size);
+            if (--len2 == 1) goto done;
+            count2 = len2 - gallopLeft(a + c1 * size, tmp, len2, len2 - 1, size, cmp);
+            if (count2 != 0) {
+                dest -= count2; c2 -= count2; len2 -= count2;
+                memcpy(a + (dest + 1) * size, tmp + (c2 + 1) * size, count2 * size);
+                if (len2 <= 1) goto done;
+            }
+            memcpy(a + dest-- * size, a + c1-- * size, size);
+            if (--len1 == 0) goto done;
+            min_gallop--;
+        } while (count1 >= SORT_MIN_GALLOP || count2 >= SORT_MIN_GALLOP);
+        if (min_gallop < 0) min_gallop = 0;
+        min_gallop += 2;
+    }
+done:
+    ts->min_gallop = min_gallop < 1 ? 1 : min_gallop;
+    if (len2 == 1) {
+        dest -= len1; c1 -= len1;
+        memmove(a + (dest + 1) * size, a + (c1 + 1) * size, len1 * size);
+        memcpy(a + dest * size, tmp + c2 * size, size);
+    } else if (len2 > 0) {
+        memcpy(a + (dest - (ptrdiff_t)len2 + 1) * size, tmp, len2 * size);
+    }
+}
+static void timMergeAt(timsort_state* ts, size_t i) {
+    size_t size = ts->size;
+    size_t base1 = ts->run_base[i], len1 = ts->run_len[i];
+    size_t base2 = ts->run_base[i + 1], len2 = ts->run_len[i + 1];
+    ts->run_len[i] = len1 + len2;
+    if (i == ts->stack_size - 3) {
+        ts->run_base[i + 1] = ts->run_base[i + 2];
+        ts->run_len[i + 1] = ts->run_len[i + 2];
+    }
+    ts->stack_size--;
+    //Elements of run1 already below run2[0] and of run2 already above the
+    //end of run1 are in their final place
+    size_t k = gallopRight(ts->arr + base2 * size, ts->arr + base1 * size, len1, 0, size, ts->cmp);
+    base1 += k;
+    len1 -= k;
+    if (len1 == 0) return;
+    len2 = gallopLeft(ts->arr + (base1 + len1 - 1) * size, ts->arr + base2 * size, len2, len2 - 1, size, ts->cmp);
+    if (len2 == 0) return;
+    //Every element is written once, plus the copy of the shorter run
+    SORT_STATS_MOVES(len1 + len2 + (len1 <= len2 ? len1 : len2));
+    if (len1 <= len2) timMergeLo(ts, base1, len1, base2, len2);
+    else timMergeHi(ts, base1, len1, base2, len2);
+}
+//Restores the run-stack invariants len[i - 2] > len[i - 1] + len[i] and len[i - 1] > len[i]
+static void timMergeCollapse(timsort_state* ts) {
+    while (ts->stack_size > 1) {
+        size_t n = ts->stack_size - 2;
+        size_t* len = ts->run_len;
+        if ((n > 0 && len[n - 1] <= len[n] + len[n + 1]) || (n > 1 && len[n - 2] <= len[n] + len[n - 1])) {
+            if (len[n - 1] < len[n + 1]) n--;
+        } else if (len[n] > len[n + 1]) {
+            break;
+        }
+        timMergeAt(ts, n);
+    }
+}
+static void timMergeForceCollapse(timsort_state* ts) {
+    while (ts->stack_size > 1) {
+        size_t n = ts->stack_size - 2;
+        if (n > 0 && ts->run_len[n - 1] < ts->run_len[n + 1]) n--;
+        timMergeAt(ts, n);
+    }
+}
+//Bytes of scratch space timSortWithBuffer needs to avoid allocating
+size_t timSortBufferSize(size_t num, size_t size) {
+    return (num / 2) * size;
+}
+//Sorts using the caller's scratch buffer; allocates once only if it is
+//smaller than timSortBufferSize(num, size)
+void timSortWithBuffer(void* base, size_t num, size_t size, compare_func_t cmp, void* buffer, size_t buffer_size) {
+    assert(base != NULL && "Array cannot be NULL");
+    assert(cmp != NULL && "Comparison function cannot be NULL");
+    SORT_CALL_BEGIN("timSortWithBuffer", num);
+    if (num <= 1) { SORT_CALL_END(); return; }
+    unsigned char* arr = (unsigned char*)base;
+    if (num < SORT_MIN_MERGE) {
+        timBinaryInsertion(arr, num, timCountRun(arr, num, size, cmp), size, cmp);
+        SORT_CALL_END();
+        return;
+    }
+    timsort_state ts;
+    ts.arr = arr;
+    ts.size = size;
+    ts.cmp = cmp;
+    ts.min_gallop = SORT_MIN_GALLOP;
+    ts.stack_size = 0;
+    void* owned = NULL;
+    if (buffer != NULL && buffer_size >= timSortBufferSize(num, size)) {
+        ts.tmp = (unsigned char*)buffer;
+    } else {
+        owned = SORT_MALLOC(timSortBufferSize(num, size));
+        if (!owned) {
+            sort_fail(SORT_ERROR_NO_MEMORY);
+            SORT_CALL_END();
+            return;
+        }
+        ts.tmp = (unsigned char*)owned;
+    }
+    size_t min_run = timMinRun(num);
+    size_t lo = 0, remaining = num;
+    do {
+        size_t run = timCountRun(arr + lo * size, remaining, size, cmp);
+        if (run < min_run) {
+            size_t force = remaining < min_run ? remaining : min_run;
+            timBinaryInsertion(arr + lo * size, force, run, size, cmp);
+            run = force;
+        }
+        ts.run_base[ts.stack_size] = lo;
+        ts.run_len[ts.stack_size] = run;
+        ts.stack_size++;
+        timMergeCollapse(&ts);
+        lo += run;
+        remaining -= run;
+    } while (remaining != 0);
+    timMergeForceCollapse(&ts);
+    SORT_FREE(owned);
+    SORT_CALL_END();
+}
+void timSort(void* base, size_t num, size_t size, compare_func_t cmp) {
+    SORT_CALL_BEGIN("timSort", num);
+    timSortWithBuffer(base, num, size, cmp, NULL, 0);
+    SORT_CALL_END();
 }
 
 //The following algorithms are specialized for integer types
 
 //14. Pigeonhole Sort
-void pigeonholeSort(int arr[], size_t n) {
-    assert(arr != NULL && "Array cannot be NULL");
-    if (n <= 1) return;
+//15. Counting Sort
+//pigeonholeSort and countingSort share one engine for int keys. The range is
+//computed in 64 bits, so any mix of INT_MIN..INT_MAX is safe. When the
+//range is small next to n (and its counters fit SORT_COUNTING_MAX_BYTES)
+//keys are counted in a dense array indexed by key - min. Otherwise they are
+//counted in an open-addressing hash table and only the distinct keys are
+//sorted, which suits a few status or enum values spread over a wide range.
+//If a sample of SORT_COUNTING_SAMPLE keys is mostly distinct, or more than
+//n / SORT_COUNTING_SPARSE_SHARE keys turn out distinct, radix sort is faster
+//and is used instead. countingSortPairs is the stable variant that
+//moves a payload with each key; parallelCountingSort (section 20) builds the
+//dense histograms on several threads.
+#ifndef SORT_COUNTING_MAX_BYTES
+#define SORT_COUNTING_MAX_BYTES ((size_t)64 << 20) // counters or hash slots
+#endif
+#ifndef SORT_COUNTING_RANGE_FACTOR
+#define SORT_COUNTING_RANGE_FACTOR 4 // dense while range <= 4n + SORT_COUNTING_MIN_RANGE
+#endif
+#ifndef SORT_COUNTING_MIN_RANGE
+#define SORT_COUNTING_MIN_RANGE 65536
+#endif
+#ifndef SORT_COUNTING_SPARSE_SHARE
+#define SORT_COUNTING_SPARSE_SHARE 8
+#endif
+#ifndef SORT_COUNTING_SAMPLE
+#define SORT_COUNTING_SAMPLE 256 // hash only if at most half the sample is distinct
+#endif
+
+void radixSortInt(int* arr, size_t num);
+void radixSortPairsInt(int* keys, void* values, size_t num, size_t value_size);
+
+typedef struct {
+    size_t count; // occurrences, then the first output position
+    int key;
+    bool used;
+} sort_count_slot;
+
+typedef struct {
+    sort_count_slot* slots;
+    size_t mask;
+    size_t distinct;
+} sort_count_table;
+
+static void sort_countRange(const int* arr, size_t n, int* min_out, uint64_t* range_out) {
     int min_val = arr[0], max_val = arr[0];
     for (size_t i = 1; i < n; i++) {
         if (arr[i] < min_val) min_val = arr[i];
         if (arr[i] > max_val) max_val = arr[i];
     }
-    int range = max_val - min_val + 1;
-    int* holes = (int*)calloc(range, sizeof(int));
-    if (!holes) return;
-    for (size_t i = 0; i < n; i++) holes[arr[i] - min_val]++;
-    size_t index = 0;
-    for (int j = 0; j < range; j++) {
-        while (holes[j]-- > 0) {
-            arr[index++] = j + min_val;
+    *min_out = min_val;
+    *range_out = (uint64_t)((int64_t)max_val - min_val) + 1;
+}
+
+static bool sort_countDense(uint64_t range, size_t n) {
+    return range <= SORT_COUNTING_MAX_BYTES / sizeof(size_t) && range <= (uint64_t)n * SORT_COUNTING_RANGE_FACTOR + SORT_COUNTING_MIN_RANGE;
+}
+
+static sort_count_slot* sort_countFind(const sort_count_table* t, int key) {
+    size_t i = (size_t)(((uint64_t)(uint32_t)key * 0x9E3779B97F4A7C15ull) >> 32) & t->mask;
+    while (t->slots[i].used && t->slots[i].key != key) i = (i + 1) & t->mask;
+    return &t->slots[i];
+}
+
+//Counts every key in a hash table kept at most half full. Returns false when
+//the table would outgrow SORT_COUNTING_MAX_BYTES or the sparse share.
+static bool sort_countHashBuild(sort_count_table* t, const int* arr, size_t n) {
+    size_t max_distinct = n / SORT_COUNTING_SPARSE_SHARE + 16;
+    size_t max_slots = SORT_COUNTING_MAX_BYTES / sizeof(sort_count_slot);
+    size_t cap = 64;
+    t->slots = (sort_count_slot*)SORT_CALLOC(cap, sizeof(sort_count_slot));
+    if (!t->slots) return false;
+    t->mask = cap - 1;
+    t->distinct = 0;
+    for (size_t i = 0; i < n; i++) {
+        sort_count_slot* s = sort_countFind(t, arr[i]);
+        if (s->used) { s->count++; continue; }
+        if (++t->distinct > max_distinct || (t->distinct * 2 > cap && cap * 2 > max_slots)) {
+            SORT_FREE(t->slots);
+            return false;
+        }
+        s->used = true;
+        s->key = arr[i];
+        s->count = 1;
+        if (t->distinct * 2 > cap) {
+            sort_count_table grown;
+            grown.slots = (sort_count_slot*)SORT_CALLOC(cap * 2, sizeof(sort_count_slot));
+            if (!grown.slots) { SORT_FREE(t->slots); return false; }
+            grown.mask = cap * 2 - 1;
+            for (size_t j = 0; j < cap; j++) {
+                if (t->slots[j].used) *sort_countFind(&grown, t->slots[j].key) = t->slots[j];
+            }
+            SORT_FREE(t->slots);
+            t->slots = grown.slots;
+            t->mask = grown.mask;
+            cap *= 2;
         }
     }
-    free(holes);
+    return true;
+}
+
+//Whether a sample of the keys is repetitive enough to be worth hashing
+static bool sort_countFewDistinct(const int* keys, size_t n) {
+    int sample[SORT_COUNTING_SAMPLE];
+    size_t m = n < SORT_COUNTING_SAMPLE ? n : SORT_COUNTING_SAMPLE;
+    for (size_t s = 0; s < m; s++) sample[s] = keys[s * (n / m)];
+    introSort(sample, m, sizeof(int), compare_ints);
+    size_t distinct = 1;
+    for (size_t s = 1; s < m; s++) distinct += sample[s] != sample[s - 1];
+    return distinct * 2 <= m;
+}
+
+//The distinct keys of the table in ascending order (distinct entries)
+static int* sort_countHashKeys(const sort_count_table* t) {
+    int* keys = (int*)SORT_MALLOC(t->distinct * sizeof(int));
+    if (!keys) return NULL;
+    size_t d = 0;
+    for (size_t j = 0; j <= t->mask; j++) if (t->slots[j].used) keys[d++] = t->slots[j].key;
+    introSort(keys, d, sizeof(int), compare_ints);
+    return keys;
+}
+
+//Sorts keys (and values when value_size > 0) by counting. Without values the
+//keys are rewritten from the counts; with values they are scattered stably.
+static void sort_countingRun(int* keys, unsigned char* values, size_t n, size_t value_size) {
+    int min_val;
+    uint64_t range;
+    sort_countRange(keys, n, &min_val, &range);
+    if (range == 1) return;
+    if (sort_countDense(range, n)) {
+        size_t* count = (size_t*)SORT_CALLOC((size_t)range, sizeof(size_t));
+        if (!count) { sort_fail(SORT_ERROR_NO_MEMORY); return; }
+        for (size_t i = 0; i < n; i++) count[(uint32_t)keys[i] - (uint32_t)min_val]++;
+        if (value_size == 0) {
+            size_t index = 0;
+            for (size_t j = 0; j < range; j++) {
+                int key = (int)((int64_t)min_val + (int64_t)j);
+                for (size_t c = count[j]; c > 0; c--) keys[index++] = key;
+            }
+            SORT_STATS_MOVES(n);
+            SORT_FREE(count);
+            return;
+        }
+        unsigned char* scratch = (unsigned char*)SORT_MALLOC(n * (sizeof(int) + value_size));
+        if (!scratch) { SORT_FREE(count); sort_fail(SORT_ERROR_NO_MEMORY); return; }
+        int* key_out = (int*)scratch;
+        unsigned char* value_out = scratch + n * sizeof(int);
+        size_t sum = 0;
+        for (size_t j = 0; j < range; j++) {
+            size_t c = count[j];
+            count[j] = sum;
+            sum += c;
+        }
+        for (size_t i = 0; i < n; i++) {
+            size_t pos = count[(uint32_t)keys[i] - (uint32_t)min_val]++;
+            key_out[pos] = keys[i];
+            memcpy(value_out + pos * value_size, values + i * value_size, value_size);
+        }
+        SORT_STATS_MOVES(2 * n);
+        memcpy(keys, key_out, n * sizeof(int));
+        memcpy(values, value_out, n * value_size);
+        SORT_FREE(scratch);
+        SORT_FREE(count);
+        return;
+    }
+    //Wide range: a hash table for few distinct keys, radix sort for many
+    sort_count_table table;
+    int* distinct = NULL;
+    if (!sort_countFewDistinct(keys, n) || !sort_countHashBuild(&table, keys, n)) table.slots = NULL;
+    if (table.slots) distinct = sort_countHashKeys(&table);
+    if (!distinct) {
+        SORT_FREE(table.slots);
+        if (value_size == 0) radixSortInt(keys, n);
+        else radixSortPairsInt(keys, values, n, value_size);
+        return;
+    }
+    if (value_size == 0) {
+        size_t index = 0;
+        for (size_t d = 0; d < table.distinct; d++) {
+            for (size_t c = sort_countFind(&table, distinct[d])->count; c > 0; c--) keys[index++] = distinct[d];
+        }
+        SORT_STATS_MOVES(n);
+    } else {
+        unsigned char* scratch = (unsigned char*)SORT_MALLOC(n * (sizeof(int) + value_size));
+        if (!scratch) {
+            SORT_FREE(distinct);
+            SORT_FREE(table.slots);
+            radixSortPairsInt(keys, values, n, value_size);
+            return;
+        }
+        int* key_out = (int*)scratch;
+        unsigned char* value_out = scratch + n * sizeof(int);
+        size_t sum = 0;
+        for (size_t d = 0; d < table.distinct; d++) {
+            sort_count_slot* s = sort_countFind(&table, distinct[d]);
+            size_t c = s->count;
+            s->count = sum;
+            sum += c;
+        }
+        for (size_t i = 0; i < n; i++) {
+            size_t pos = sort_countFind(&table, keys[i])->count++;
+            key_out[pos] = keys[i];
+            memcpy(value_out + pos * value_size, values + i * value_size, value_size);
+        }
+        SORT_STATS_MOVES(2 * n);
+        memcpy(keys, key_out, n * sizeof(int));
+        memcpy(values, value_out, n * value_size);
+        SORT_FREE(scratch);
+    }
+    SORT_FREE(distinct);
+    SORT_FREE(table.slots);
+}
+
+void pigeonholeSort(int arr[], size_t n) {
+    assert(arr != NULL && "Array cannot be NULL");
+    SORT_CALL_BEGIN("pigeonholeSort", n);
+    if (n > 1) sort_countingRun(arr, NULL, n, 0);
+    SORT_CALL_END();
 }
 
-//15. Counting Sort
 void countingSort(int arr[], size_t n) {
     assert(arr != NULL && "Array cannot be NULL");
-    if (n <= 1) return;
-    int max_val = arr[0];
-    for (size_t i = 1; i < n; i++) if (arr[i] > max_val) max_val = arr[i];
-    int* count = (int*)calloc(max_val + 1, sizeof(int));
-    if (!count) return;
-    int* output = (int*)malloc(n * sizeof(int));
-    if (!output) { free(count); return; }
-    for (size_t i = 0; i < n; i++) count[arr[i]]++;
-    for (int i = 1; i <= max_val; i++) count[i] += count[i - 1];
-    for (long i = n - 1; i >= 0; i--) {
-        output[count[arr[i]] - 1] = arr[i];
-        count[arr[i]]--;
-    }
-    memcpy(arr, output, n * sizeof(int));
-    free(count); free(output);
+    SORT_CALL_BEGIN("countingSort", n);
+    if (n > 1) sort_countingRun(arr, NULL, n, 0);
+    SORT_CALL_END();
+}
+
+//Stable key-value sort: values[i] (value_size bytes each) travels with keys[i]
+void countingSortPairs(int* keys, void* values, size_t n, size_t value_size) {
+    assert(keys != NULL && "Array cannot be NULL");
+    assert(values != NULL && "Values cannot be NULL");
+    SORT_CALL_BEGIN("countingSortPairs", n);
+    if (n > 1) {
+        if (value_size == 0) sort_countingRun(keys, NULL, n, 0);
+        else sort_countingRun(keys, (unsigned char*)values, n, value_size);
+    }
+    SORT_CALL_END();
 }
 
 //16. Radix Sort
-static int getMax(int arr[], size_t n) {
-    int max = arr[0];
-    for (size_t i = 1; i < n; i++) if (arr[i] > max) max = arr[i];
-    return max;
-}
-static void countSortRadix(int arr[], size_t n, int exp) {
-    int* output = (int*)malloc(n * sizeof(int));
-    if (!output) return;
-    int count[10] = {0};
-    for (size_t i = 0; i < n; i++) count[(arr[i] / exp) % 10]++;
-    for (int i = 1; i < 10; i++) count[i] += count[i - 1];
-    for (long i = n - 1; i >= 0; i--) {
-        output[count[(arr[i] / exp) % 10] - 1] = arr[i];
-        count[(arr[i] / exp) % 10]--;
-    }
-    memcpy(arr, output, n * sizeof(int));
-    free(output);
+//LSD radix sort over 8-bit digits. Keys are mapped to unsigned integers that
+//order the same way (sign bit flipped for signed types, IEEE sign/magnitude
+//folded for floating point), the histograms for every digit are built in a
+//single pass, digits where all keys share one bucket are skipped, and the
+//data ping-pongs between the array and one scratch buffer.
+//SORT_DEFINE_RADIX_SORT(Name, T, U, TO_KEY) generates radixSort##Name,
+//radixSort##Name##WithBuffer and radixSortPairs##Name for keys of type T
+//whose bit pattern is the unsigned type U; TO_KEY(U, bits) is one of the
+//SORT_RADIX_KEY_* transforms below.
+#define SORT_RADIX_BITS 8
+#define SORT_RADIX_BUCKETS (1 << SORT_RADIX_BITS)
+#ifndef SORT_RADIX_MIN
+#define SORT_RADIX_MIN 64
+#endif
+#define SORT_RADIX_SIGN(U) ((U)1 << (sizeof(U) * CHAR_BIT - 1))
+#define SORT_RADIX_KEY_UNSIGNED(U, x) (x)
+#define SORT_RADIX_KEY_SIGNED(U, x) ((U)((x) ^ SORT_RADIX_SIGN(U)))
+#define SORT_RADIX_KEY_FLOAT(U, x) ((U)(((x) & SORT_RADIX_SIGN(U)) ? ~(x) : ((x) | SORT_RADIX_SIGN(U))))
+static void sort_copy_value(void* dst, const void* src, size_t size) {
+    switch (size) {
+        case 4: { uint32_t v; memcpy(&v, src, 4); memcpy(dst, &v, 4); break; }
+        case 8: { uint64_t v; memcpy(&v, src, 8); memcpy(dst, &v, 8); break; }
+        default: memcpy(dst, src, size); break;
+    }
+}
+#define SORT_DEFINE_RADIX_SORT(Name, T, U, TO_KEY) \
+static U sort_radix_##Name##_key(const T* p) { \
+    U bits; \
+    memcpy(&bits, p, sizeof(U)); \
+    return TO_KEY(U, bits); \
+} \
+static void sort_radix_##Name##_run(T* arr, T* scratch, unsigned char* vals, unsigned char* vscratch, size_t vsize, size_t num) { \
+    size_t counts[sizeof(U)][SORT_RADIX_BUCKETS]; \
+    memset(counts, 0, sizeof(counts)); \
+    for (size_t i = 0; i < num; i++) { \
+        U k = sort_radix_##Name##_key(arr + i); \
+        for (size_t p = 0; p < sizeof(U); p++) { \
+            counts[p][(k >> (p * SORT_RADIX_BITS)) & (SORT_RADIX_BUCKETS - 1)]++; \
+        } \
+    } \
+    T* src = arr; T* dst = scratch; \
+    unsigned char* vsrc = vals; unsigned char* vdst = vscratch; \
+    for (size_t p = 0; p < sizeof(U); p++) { \
+        size_t shift = p * SORT_RADIX_BITS; \
+        size_t* c = counts[p]; \
+        if (c[(sort_radix_##Name##_key(src) >> shift) & (SORT_RADIX_BUCKETS - 1)] == num) continue; \
+        size_t sum = 0; \
+        for (size_t b = 0; b < SORT_RADIX_BUCKETS; b++) { \
+            size_t t = c[b]; \
+            c[b] = sum; \
+            sum += t; \
+        } \
+        if (vsrc) { \
+            for (size_t i = 0; i < num; i++) { \
+                size_t pos = c[(sort_radix_##Name##_key(src + i) >> shift) & (SORT_RADIX_BUCKETS - 1)]++; \
+                dst[pos] = src[i]; \
+                sort_copy_value(vdst + pos * vsize, vsrc + i * vsize, vsize); \
+            } \
+            unsigned char* vt = vsrc; vsrc = vdst; vdst = vt; \
+        } else { \
+            for (size_t i = 0; i < num; i++) { \
+                dst[c[(sort_radix_##Name##_key(src + i) >> shift) & (SORT_RADIX_BUCKETS - 1)]++] = src[i]; \
+            } \
+        } \
+        T* t = src; src = dst; dst = t; \
+    } \
+    if (src != arr) { \
+        memcpy(arr, src, num * sizeof(T)); \
+        if (vals) memcpy(vals, vsrc, num * vsize); \
+    } \
+} \
+/* buffer must hold num elements of T */ \
+void radixSort##Name##WithBuffer(T* arr, size_t num, T* buffer) { \
+    assert(arr != NULL && "Array cannot be NULL"); \
+    assert(buffer != NULL && "Buffer cannot be NULL"); \
+    SORT_CALL_BEGIN("radixSort" #Name "WithBuffer", num); \
+    if (num <= 1) { SORT_CALL_END(); return; } \
+    sort_radix_##Name##_run(arr, buffer, NULL, NULL, 0, num); \
+    SORT_CALL_END(); \
+} \
+void radixSort##Name(T* arr, size_t num) { \
+    assert(arr != NULL && "Array cannot be NULL"); \
+    SORT_CALL_BEGIN("radixSort" #Name, num); \
+    if (num <= 1) { SORT_CALL_END(); return; } \
+    if (num < SORT_RADIX_MIN) { \
+        for (size_t i = 1; i < num; i++) { \
+            T v = arr[i]; \
+            U k = sort_radix_##Name##_key(&v); \
+            size_t j = i; \
+            while (j > 0 && k < sort_radix_##Name##_key(arr + j - 1)) { \
+                arr[j] = arr[j - 1]; \
+                j--; \
+            } \
+            arr[j] = v; \
+        } \
+        SORT_CALL_END(); \
+        return; \
+    } \
+    T* scratch = (T*)SORT_MALLOC(num * sizeof(T)); \
+    if (!scratch) { sort_fail(SORT_ERROR_NO_MEMORY); SORT_CALL_END(); return; } \
+    sort_radix_##Name##_run(arr, scratch, NULL, NULL, 0, num); \
+    SORT_FREE(scratch); \
+    SORT_CALL_END(); \
+} \
+/* Stable key-value sort: values[i] (value_size bytes each) travels with keys[i] */ \
+void radixSortPairs##Name(T* keys, void* values, size_t num, size_t value_size) { \
+    assert(keys != NULL && "Array cannot be NULL"); \
+    assert(values != NULL && "Values cannot be NULL"); \
+    SORT_CALL_BEGIN("radixSortPairs" #Name, num); \
+    if (num <= 1) { SORT_CALL_END(); return; } \
+    unsigned char* scratch = (unsigned char*)SORT_MALLOC(num * (sizeof(T) + value_size)); \
+    if (!scratch) { sort_fail(SORT_ERROR_NO_MEMORY); SORT_CALL_END(); return; } \
+    sort_radix_##Name##_run(keys, (T*)scratch, (unsigned char*)values, scratch + num * sizeof(T), value_size, num); \
+    SORT_FREE(scratch); \
+    SORT_CALL_END(); \
 }
+
+SORT_DEFINE_RADIX_SORT(Int, int, unsigned int, SORT_RADIX_KEY_SIGNED)
+SORT_DEFINE_RADIX_SORT(Int32, int32_t, uint32_t, SORT_RADIX_KEY_SIGNED)
+SORT_DEFINE_RADIX_SORT(UInt32, uint32_t, uint32_t, SORT_RADIX_KEY_UNSIGNED)
+SORT_DEFINE_RADIX_SORT(Int64, int64_t, uint64_t, SORT_RADIX_KEY_SIGNED)
+SORT_DEFINE_RADIX_SORT(UInt64, uint64_t, uint64_t, SORT_RADIX_KEY_UNSIGNED)
+SORT_DEFINE_RADIX_SORT(Float, float, uint32_t, SORT_RADIX_KEY_FLOAT)
+SORT_DEFINE_RADIX_SORT(Double, double, uint64_t, SORT_RADIX_KEY_FLOAT)
+
 void radixSort(int arr[], size_t n) {
     assert(arr != NULL && "Array cannot be NULL");
-    if (n <= 1) return;
-    int m = getMax(arr, n);
-    for (int exp = 1; m / exp > 0; exp *= 10) {
-        countSortRadix(arr, n, exp);
-    }
+    SORT_CALL_BEGIN("radixSort", n);
+    radixSortInt(arr, n);
+    SORT_CALL_END();
 }
 
 //17. Bucket Sort
+//Sample sort: splitters are taken from a sorted random sample, each key finds
+//its bucket by a branch-free walk down an implicit binary tree of splitters,
+//and the buckets are laid out back to back in one prefix-summed slab. The
+//bucket count is chosen so an average bucket fits in SORT_BUCKET_CACHE
+//bytes. Buckets over four times that are split again, unless one bucket
+//holds most of its parent, the sample is all one key (heavy duplicates) or
+//SORT_BUCKET_MAX_DEPTH is reached; those, like all smaller buckets, are
+//finished by quickSortInt. Any int values, negative ones included, work.
+//The bucket of every key is remembered in a byte array, so classification
+//runs once; the slab costs n * (sizeof(int) + 1) bytes.
+#ifndef SORT_BUCKET_CACHE
+#define SORT_BUCKET_CACHE (64 * 1024) // target bucket bytes, about half an L2
+#endif
+#ifndef SORT_BUCKET_OVERSAMPLE
+#define SORT_BUCKET_OVERSAMPLE 16 // sample keys per bucket
+#endif
+#ifndef SORT_BUCKET_MAX_DEPTH
+#define SORT_BUCKET_MAX_DEPTH 4
+#endif
+#define SORT_BUCKET_MAX 256 // bucket numbers are stored in one byte
+
+void quickSortInt(int* arr, size_t num);
+
+typedef struct {
+    int tree[SORT_BUCKET_MAX]; // splitters in heap order, tree[1] is the median
+    size_t levels;
+    size_t buckets;
+} sort_bucket_splitters;
+
+static void sort_bucketTree(sort_bucket_splitters* sp, const int* sorted, size_t node, size_t lo, size_t hi) {
+    if (node >= sp->buckets) return;
+    size_t mid = lo + (hi - lo) / 2;
+    sp->tree[node] = sorted[mid];
+    sort_bucketTree(sp, sorted, 2 * node, lo, mid);
+    sort_bucketTree(sp, sorted, 2 * node + 1, mid + 1, hi);
+}
+
+//Buckets for n keys: a power of two with average buckets of about
+//SORT_BUCKET_CACHE bytes, or 0 when the keys fit in a few buckets' worth
+static size_t sort_bucketCount(size_t n) {
+    size_t target = SORT_BUCKET_CACHE / sizeof(int);
+    if (n <= 4 * target) return 0;
+    size_t buckets = 2;
+    while (buckets < SORT_BUCKET_MAX && buckets * target < n) buckets *= 2;
+    return buckets;
+}
+
+//Picks buckets - 1 splitters from a sample of buckets * SORT_BUCKET_OVERSAMPLE
+//keys. Returns false when every sampled key is equal, so splitting is useless.
+static bool sort_bucketSample(sort_bucket_splitters* sp, const int* arr, size_t n, size_t buckets) {
+    int sample[SORT_BUCKET_MAX * SORT_BUCKET_OVERSAMPLE];
+    size_t m = buckets * SORT_BUCKET_OVERSAMPLE;
+    uint64_t state = 0x9E3779B97F4A7C15ull ^ n;
+    for (size_t s = 0; s < m; s++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        sample[s] = arr[state % n];
+    }
+    quickSortInt(sample, m);
+    if (sample[0] == sample[m - 1]) return false;
+    int splitters[SORT_BUCKET_MAX];
+    for (size_t b = 1; b < buckets; b++) splitters[b - 1] = sample[b * SORT_BUCKET_OVERSAMPLE - 1];
+    sp->buckets = buckets;
+    sp->levels = 0;
+    while (((size_t)1 << sp->levels) < buckets) sp->levels++;
+    sort_bucketTree(sp, splitters, 1, 0, buckets - 1);
+    return true;
+}
+
+static inline size_t sort_bucketOf(const sort_bucket_splitters* sp, int key) {
+    size_t j = 1;
+    for (size_t l = 0; l < sp->levels; l++) j = 2 * j + (size_t)(key > sp->tree[j]);
+    return j - sp->buckets;
+}
+
+//Writes the bucket of every key to oracle and adds it to count. Four keys
+//walk the tree together so their loads and compares overlap.
+static void sort_bucketClassify(const sort_bucket_splitters* sp, const int* arr, unsigned char* oracle, size_t n, size_t* count) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        size_t j0 = 1, j1 = 1, j2 = 1, j3 = 1;
+        for (size_t l = 0; l < sp->levels; l++) {
+            j0 = 2 * j0 + (size_t)(arr[i] > sp->tree[j0]);
+            j1 = 2 * j1 + (size_t)(arr[i + 1] > sp->tree[j1]);
+            j2 = 2 * j2 + (size_t)(arr[i + 2] > sp->tree[j2]);
+            j3 = 2 * j3 + (size_t)(arr[i + 3] > sp->tree[j3]);
+        }
+        oracle[i] = (unsigned char)(j0 - sp->buckets);
+        oracle[i + 1] = (unsigned char)(j1 - sp->buckets);
+        oracle[i + 2] = (unsigned char)(j2 - sp->buckets);
+        oracle[i + 3] = (unsigned char)(j3 - sp->buckets);
+        count[j0 - sp->buckets]++;
+        count[j1 - sp->buckets]++;
+        count[j2 - sp->buckets]++;
+        count[j3 - sp->buckets]++;
+    }
+    for (; i < n; i++) {
+        size_t b = sort_bucketOf(sp, arr[i]);
+        oracle[i] = (unsigned char)b;
+        count[b]++;
+    }
+}
+
+//Sorts arr[0, n) using scratch[0, n) and oracle[0, n) as workspace
+static void sort_bucketRun(int* arr, int* scratch, unsigned char* oracle, size_t n, size_t depth) {
+    size_t buckets = sort_bucketCount(n);
+    sort_bucket_splitters sp;
+    if (buckets == 0 || depth >= SORT_BUCKET_MAX_DEPTH || !sort_bucketSample(&sp, arr, n, buckets)) {
+        quickSortInt(arr, n);
+        return;
+    }
+    size_t start[SORT_BUCKET_MAX + 1] = {0};
+    sort_bucketClassify(&sp, arr, oracle, n, start + 1);
+    for (size_t b = 0; b < buckets; b++) start[b + 1] += start[b];
+    size_t fill[SORT_BUCKET_MAX];
+    memcpy(fill, start, buckets * sizeof(size_t));
+    for (size_t i = 0; i < n; i++) scratch[fill[oracle[i]]++] = arr[i];
+    memcpy(arr, scratch, n * sizeof(int));
+    SORT_STATS_MOVES(2 * n);
+    for (size_t b = 0; b < buckets; b++) {
+        size_t lo = start[b], count = start[b + 1] - lo;
+        if (count <= 1) continue;
+        if (count > n / 2) quickSortInt(arr + lo, count); // no progress: duplicates
+        else sort_bucketRun(arr + lo, scratch + lo, oracle + lo, count, depth + 1);
+    }
+}
+
 void bucketSort(int arr[], size_t n) {
     assert(arr != NULL && "Array cannot be NULL");
-    if (n <= 1) return;
-    const int numBuckets = 10;
-    int max_val = getMax(arr, n);
-    if (max_val < 0) return; // Cannot sort negative numbers
-    int bucketSize = (max_val / numBuckets) + 1;
-    int** buckets = (int**)calloc(numBuckets, sizeof(int*));
-    if (!buckets) return;
-    int* bucketCounts = (int*)calloc(numBuckets, sizeof(int));
-    if (!bucketCounts) { free(buckets); return; }
+    SORT_CALL_BEGIN("bucketSort", n);
+    if (n <= 1) { SORT_CALL_END(); return; }
+    if (sort_bucketCount(n) == 0) {
+        quickSortInt(arr, n);
+        SORT_CALL_END();
+        return;
+    }
+    unsigned char* slab = (unsigned char*)SORT_MALLOC(n * (sizeof(int) + 1));
+    if (!slab) {
+        //In-place fallback; still O(n log n)
+        quickSortInt(arr, n);
+        SORT_CALL_END();
+        return;
+    }
+    sort_bucketRun(arr, (int*)slab, slab + n * sizeof(int), n, 0);
+    SORT_FREE(slab);
+    SORT_CALL_END();
+}
 
-    for (size_t i = 0; i < n; i++) {
-        int bucketIndex = arr[i] / bucketSize;
-        if (bucketCounts[bucketIndex] == 0) {
-            buckets[bucketIndex] = (int*)malloc(n * sizeof(int));
-            if (!buckets[bucketIndex]) {
-                for (int j = 0; j < numBuckets; j++) if(buckets[j]) free(buckets[j]);
-                free(buckets); free(bucketCounts);
-                return;
-            }
-        }
-        buckets[bucketIndex][bucketCounts[bucketIndex]++] = arr[i];
+//SIMD kernels
+//AVX2 versions of the two hot loops behind quickSortInt, quickSortFloat and
+//quickSortInt64. Partitioning classifies a whole vector per compare and
+//compacts it with a lane permutation, writing in place from both ends.
+//Blocks of up to SORT_SIMD_BLOCK elements are finished by a bitonic sorting
+//network built from vector min/max. Runs of equal keys are skipped when the
+//pivot matches the previous one. The kernels are compiled with a target
+//attribute and selected by CPU feature detection, so the header builds for
+//any x86 target and machines without AVX2 use the scalar engines.
+#ifndef SORT_SIMD_BLOCK
+#define SORT_SIMD_BLOCK 128
+#endif
+//Blocks are padded to a power of two of at least 8 lanes, so the scratch
+//buffer is SORT_SIMD_BLOCK rounded up that way
+#define SORT_SIMD_POW2_1 ((size_t)(SORT_SIMD_BLOCK) - 1)
+#define SORT_SIMD_POW2_2 (SORT_SIMD_POW2_1 | SORT_SIMD_POW2_1 >> 1)
+#define SORT_SIMD_POW2_4 (SORT_SIMD_POW2_2 | SORT_SIMD_POW2_2 >> 2)
+#define SORT_SIMD_POW2_8 (SORT_SIMD_POW2_4 | SORT_SIMD_POW2_4 >> 4)
+#define SORT_SIMD_POW2_16 (SORT_SIMD_POW2_8 | SORT_SIMD_POW2_8 >> 8)
+#define SORT_SIMD_POW2 ((SORT_SIMD_POW2_16 | SORT_SIMD_POW2_16 >> 16) + 1)
+#define SORT_SIMD_BUF (SORT_SIMD_POW2 > 8 ? SORT_SIMD_POW2 : 8)
+#define SORT_NO_KERNEL(arr, num) false
+#ifdef SORT_HAS_AVX2
+#define SORT_AVX2 __attribute__((target("avx2")))
+//Lane permutations that move the lanes whose mask bit is clear to the front
+//(in order) followed by the others; 4-bit source lane per destination lane
+static const uint32_t sort_avx2_perm8[256] = {
+    0x76543210, 0x07654321, 0x17654320, 0x10765432, 0x27654310, 0x20765431, 0x21765430, 0x21076543,
+    0x37654210, 0x30765421, 0x31765420, 0x31076542, 0x32765410, 0x32076541, 0x32176540, 0x32107654,
+    0x47653210, 0x40765321, 0x41765320, 0x41076532, 0x42765310, 0x42076531, 0x42176530, 0x42107653,
+    0x43765210, 0x43076521, 0x43176520, 0x43107652, 0x43276510, 0x43207651, 0x43217650, 0x43210765,
+    0x57643210, 0x50764321, 0x51764320, 0x51076432, 0x52764310, 0x52076431, 0x52176430, 0x52107643,
+    0x53764210, 0x53076421, 0x53176420, 0x53107642, 0x53276410, 0x53207641, 0x53217640, 0x53210764,
+    0x54763210, 0x54076321, 0x54176320, 0x54107632, 0x54276310, 0x54207631, 0x54217630, 0x54210763,
+    0x54376210, 0x54307621, 0x54317620, 0x54310762, 0x54327610, 0x54320761, 0x54321760, 0x54321076,
+    0x67543210, 0x60754321, 0x61754320, 0x61075432, 0x62754310, 0x62075431, 0x62175430, 0x62107543,
+    0x63754210, 0x63075421, 0x63175420, 0x63107542, 0x63275410, 0x63207541, 0x63217540, 0x63210754,
+    0x64753210, 0x64075321, 0x64175320, 0x64107532, 0x64275310, 0x64207531, 0x64217530, 0x64210753,
+    0x64375210, 0x64307521, 0x64317520, 0x64310752, 0x64327510, 0x64320751, 0x64321750, 0x64321075,
+    0x65743210, 0x65074321, 0x65174320, 0x65107432, 0x65274310, 0x65207431, 0x65217430, 0x65210743,
+    0x65374210, 0x65307421, 0x65317420, 0x65310742, 0x65327410, 0x65320741, 0x65321740, 0x65321074,
+    0x65473210, 0x65407321, 0x65417320, 0x65410732, 0x65427310, 0x65420731, 0x65421730, 0x65421073,
+    0x65437210, 0x65430721, 0x65431720, 0x65431072, 0x65432710, 0x65432071, 0x65432170, 0x65432107,
+    0x76543210, 0x70654321, 0x71654320, 0x71065432, 0x72654310, 0x72065431, 0x72165430, 0x72106543,
+    0x73654210, 0x73065421, 0x73165420, 0x73106542, 0x73265410, 0x73206541, 0x73216540, 0x73210654,
+    0x74653210, 0x74065321, 0x74165320, 0x74106532, 0x74265310, 0x74206531, 0x74216530, 0x74210653,
+    0x74365210, 0x74306521, 0x74316520, 0x74310652, 0x74326510, 0x74320651, 0x74321650, 0x74321065,
+    0x75643210, 0x75064321, 0x75164320, 0x75106432, 0x75264310, 0x75206431, 0x75216430, 0x75210643,
+    0x75364210, 0x75306421, 0x75316420, 0x75310642, 0x75326410, 0x75320641, 0x75321640, 0x75321064,
+    0x75463210, 0x75406321, 0x75416320, 0x75410632, 0x75426310, 0x75420631, 0x75421630, 0x75421063,
+    0x75436210, 0x75430621, 0x75431620, 0x75431062, 0x75432610, 0x75432061, 0x75432160, 0x75432106,
+    0x76543210, 0x76054321, 0x76154320, 0x76105432, 0x76254310, 0x76205431, 0x76215430, 0x76210543,
+    0x76354210, 0x76305421, 0x76315420, 0x76310542, 0x76325410, 0x76320541, 0x76321540, 0x76321054,
+    0x76453210, 0x76405321, 0x76415320, 0x76410532, 0x76425310, 0x76420531, 0x76421530, 0x76421053,
+    0x76435210, 0x76430521, 0x76431520, 0x76431052, 0x76432510, 0x76432051, 0x76432150, 0x76432105,
+    0x76543210, 0x76504321, 0x76514320, 0x76510432, 0x76524310, 0x76520431, 0x76521430, 0x76521043,
+    0x76534210, 0x76530421, 0x76531420, 0x76531042, 0x76532410, 0x76532041, 0x76532140, 0x76532104,
+    0x76543210, 0x76540321, 0x76541320, 0x76541032, 0x76542310, 0x76542031, 0x76542130, 0x76542103,
+    0x76543210, 0x76543021, 0x76543120, 0x76543102, 0x76543210, 0x76543201, 0x76543210, 0x76543210,
+};
+//Same for four 64-bit lanes, expressed as pairs of 32-bit lanes
+static const uint32_t sort_avx2_perm4[16] = {
+    0x76543210, 0x10765432, 0x32765410, 0x32107654, 0x54763210, 0x54107632, 0x54327610, 0x54321076,
+    0x76543210, 0x76105432, 0x76325410, 0x76321054, 0x76543210, 0x76541032, 0x76543210, 0x76543210,
+};
+static SORT_AVX2 __m256i sort_avx2_permIndex(uint32_t packed) {
+    __m256i shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+    return _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32((int)packed), shifts), _mm256_set1_epi32(15));
+}
+
+//int: 8 x 32-bit lanes
+static SORT_AVX2 __m256i sort_avx2_i32_load(const int* p) { return _mm256_loadu_si256((const __m256i*)p); }
+static SORT_AVX2 void sort_avx2_i32_store(int* p, __m256i v) { _mm256_storeu_si256((__m256i*)p, v); }
+static SORT_AVX2 __m256i sort_avx2_i32_set1(int x) { return _mm256_set1_epi32(x); }
+static SORT_AVX2 __m256i sort_avx2_i32_min(__m256i a, __m256i b) { return _mm256_min_epi32(a, b); }
+static SORT_AVX2 __m256i sort_avx2_i32_max(__m256i a, __m256i b) { return _mm256_max_epi32(a, b); }
+static SORT_AVX2 unsigned sort_avx2_i32_gtMask(__m256i a, __m256i b) {
+    return (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, b)));
+}
+static SORT_AVX2 unsigned sort_avx2_i32_geMask(__m256i a, __m256i b) { return ~sort_avx2_i32_gtMask(b, a) & 0xFF; }
+static SORT_AVX2 __m256i sort_avx2_i32_compress(__m256i v, unsigned mask) {
+    return _mm256_permutevar8x32_epi32(v, sort_avx2_permIndex(sort_avx2_perm8[mask]));
+}
+static SORT_AVX2 __m256i sort_avx2_i32_reverse(__m256i v) {
+    return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+}
+//Compare-exchange lane i with lane i ^ j (j < 8), smaller value to the lower lane
+static SORT_AVX2 __m256i sort_avx2_i32_cx(__m256i v, size_t j) {
+    __m256i p;
+    switch (j) {
+        case 1: p = _mm256_shuffle_epi32(v, 0xB1); return _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), 0xAA);
+        case 2: p = _mm256_shuffle_epi32(v, 0x4E); return _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), 0xCC);
+        default: p = _mm256_permute2x128_si256(v, v, 1); return _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), 0xF0);
     }
-    
-    size_t k = 0;
-    for (int i = 0; i < numBuckets; i++) {
-        if (bucketCounts[i] > 0) {
-            insertionSort(buckets[i], bucketCounts[i], sizeof(int), compare_ints);
-            for (int j = 0; j < bucketCounts[i]; j++) {
-                arr[k++] = buckets[i][j];
-            }
-            free(buckets[i]);
-        }
+}
+//Compare-exchange lane i with lane i ^ (k - 1) inside groups of k lanes
+static SORT_AVX2 __m256i sort_avx2_i32_flip(__m256i v, size_t k) {
+    __m256i p;
+    switch (k) {
+        case 2: return sort_avx2_i32_cx(v, 1);
+        case 4: p = _mm256_shuffle_epi32(v, 0x1B); return _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), 0xCC);
+        default: p = sort_avx2_i32_reverse(v); return _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), 0xF0);
     }
-    free(buckets); free(bucketCounts);
 }
 
+//float: 8 x 32-bit lanes
+static SORT_AVX2 __m256 sort_avx2_f32_load(const float* p) { return _mm256_loadu_ps(p); }
+static SORT_AVX2 void sort_avx2_f32_store(float* p, __m256 v) { _mm256_storeu_ps(p, v); }
+static SORT_AVX2 __m256 sort_avx2_f32_set1(float x) { return _mm256_set1_ps(x); }
+//Float compare-exchanges pick lanes with one _CMP_LT_OQ mask and a blend
+//rather than min_ps/max_ps, which return their second operand on ties: for a
+//-0.0/+0.0 pair that would output two copies of one of them
+static SORT_AVX2 __m256 sort_avx2_f32_min(__m256 a, __m256 b) { return _mm256_blendv_ps(a, b, _mm256_cmp_ps(b, a, _CMP_LT_OQ)); }
+static SORT_AVX2 __m256 sort_avx2_f32_max(__m256 a, __m256 b) { return _mm256_blendv_ps(b, a, _mm256_cmp_ps(b, a, _CMP_LT_OQ)); }
+static SORT_AVX2 unsigned sort_avx2_f32_gtMask(__m256 a, __m256 b) { return (unsigned)_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+static SORT_AVX2 unsigned sort_avx2_f32_geMask(__m256 a, __m256 b) { return (unsigned)_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ)); }
+static SORT_AVX2 __m256 sort_avx2_f32_compress(__m256 v, unsigned mask) {
+    return _mm256_permutevar8x32_ps(v, sort_avx2_permIndex(sort_avx2_perm8[mask]));
+}
+static SORT_AVX2 __m256 sort_avx2_f32_reverse(__m256 v) {
+    return _mm256_permutevar8x32_ps(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+}
+//Exchanges v with its partner lanes p: the lanes set in high keep the larger
+//value, the others the smaller. Both lanes of a pair swap exactly when the
+//high one is less, so the output is always a permutation of v.
+static SORT_AVX2 __m256 sort_avx2_f32_exchange(__m256 v, __m256 p, __m256 high) {
+    __m256 low_swap = _mm256_cmp_ps(p, v, _CMP_LT_OQ);
+    __m256 high_swap = _mm256_cmp_ps(v, p, _CMP_LT_OQ);
+    return _mm256_blendv_ps(v, p, _mm256_blendv_ps(low_swap, high_swap, high));
+}
+static SORT_AVX2 __m256 sort_avx2_f32_highLanes(int mask) {
+    return _mm256_castsi256_ps(_mm256_setr_epi32(
+        -(mask & 1), -((mask >> 1) & 1), -((mask >> 2) & 1), -((mask >> 3) & 1),
+        -((mask >> 4) & 1), -((mask >> 5) & 1), -((mask >> 6) & 1), -((mask >> 7) & 1)));
+}
+static SORT_AVX2 __m256 sort_avx2_f32_cx(__m256 v, size_t j) {
+    switch (j) {
+        case 1: return sort_avx2_f32_exchange(v, _mm256_shuffle_ps(v, v, 0xB1), sort_avx2_f32_highLanes(0xAA));
+        case 2: return sort_avx2_f32_exchange(v, _mm256_shuffle_ps(v, v, 0x4E), sort_avx2_f32_highLanes(0xCC));
+        default: return sort_avx2_f32_exchange(v, _mm256_permute2f128_ps(v, v, 1), sort_avx2_f32_highLanes(0xF0));
+    }
+}
+static SORT_AVX2 __m256 sort_avx2_f32_flip(__m256 v, size_t k) {
+    switch (k) {
+        case 2: return sort_avx2_f32_cx(v, 1);
+        case 4: return sort_avx2_f32_exchange(v, _mm256_shuffle_ps(v, v, 0x1B), sort_avx2_f32_highLanes(0xCC));
+        default: return sort_avx2_f32_exchange(v, sort_avx2_f32_reverse(v), sort_avx2_f32_highLanes(0xF0));
+    }
+}
+
+//int64_t: 4 x 64-bit lanes; AVX2 has no 64-bit min/max, so they are built
+//from a compare and a blend
+static SORT_AVX2 __m256i sort_avx2_i64_load(const int64_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+static SORT_AVX2 void sort_avx2_i64_store(int64_t* p, __m256i v) { _mm256_storeu_si256((__m256i*)p, v); }
+static SORT_AVX2 __m256i sort_avx2_i64_set1(int64_t x) { return _mm256_set1_epi64x((long long)x); }
+static SORT_AVX2 __m256i sort_avx2_i64_min(__m256i a, __m256i b) { return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b)); }
+static SORT_AVX2 __m256i sort_avx2_i64_max(__m256i a, __m256i b) { return _mm256_blendv_epi8(b, a, _mm256_cmpgt_epi64(a, b)); }
+static SORT_AVX2 unsigned sort_avx2_i64_gtMask(__m256i a, __m256i b) {
+    return (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(a, b)));
+}
+static SORT_AVX2 unsigned sort_avx2_i64_geMask(__m256i a, __m256i b) { return ~sort_avx2_i64_gtMask(b, a) & 0xF; }
+static SORT_AVX2 __m256i sort_avx2_i64_compress(__m256i v, unsigned mask) {
+    return _mm256_permutevar8x32_epi32(v, sort_avx2_permIndex(sort_avx2_perm4[mask]));
+}
+static SORT_AVX2 __m256i sort_avx2_i64_reverse(__m256i v) { return _mm256_permute4x64_epi64(v, 0x1B); }
+static SORT_AVX2 __m256i sort_avx2_i64_cx(__m256i v, size_t j) {
+    __m256i p = j == 1 ? _mm256_permute4x64_epi64(v, 0xB1) : _mm256_permute4x64_epi64(v, 0x4E);
+    __m256i mn = sort_avx2_i64_min(v, p), mx = sort_avx2_i64_max(v, p);
+    return j == 1 ? _mm256_blend_epi32(mn, mx, 0xCC) : _mm256_blend_epi32(mn, mx, 0xF0);
+}
+static SORT_AVX2 __m256i sort_avx2_i64_flip(__m256i v, size_t k) {
+    if (k == 2) return sort_avx2_i64_cx(v, 1);
+    __m256i p = sort_avx2_i64_reverse(v);
+    return _mm256_blend_epi32(sort_avx2_i64_min(v, p), sort_avx2_i64_max(v, p), 0xF0);
+}
+
+//SORT_AVX2_DEFINE_KERNELS(X, T, W, V, T_MAX, HEAP) builds the network,
+//partition and quicksort for the sort_avx2_X_* lane operations above
+#define SORT_AVX2_DEFINE_KERNELS(X, T, W, V, T_MAX, HEAP) \
+/* Ascending bitonic network over a[0, m), m a power of two >= W */ \
+static SORT_AVX2 void sort_avx2_##X##_network(T* a, size_t m) { \
+    for (size_t k = 2; k <= m; k <<= 1) { \
+        size_t j = k / 4; \
+        if (k > W) { \
+            for (size_t b = 0; b < m; b += k) { \
+                for (size_t i = 0; i < k / 2; i += W) { \
+                    V x = sort_avx2_##X##_load(a + b + i); \
+                    V y = sort_avx2_##X##_reverse(sort_avx2_##X##_load(a + b + k - i - W)); \
+                    sort_avx2_##X##_store(a + b + i, sort_avx2_##X##_min(x, y)); \
+                    sort_avx2_##X##_store(a + b + k - i - W, sort_avx2_##X##_reverse(sort_avx2_##X##_max(x, y))); \
+                } \
+            } \
+            for (; j >= W; j >>= 1) { \
+                for (size_t b = 0; b < m; b += 2 * j) { \
+                    for (size_t i = 0; i < j; i += W) { \
+                        V x = sort_avx2_##X##_load(a + b + i); \
+                        V y = sort_avx2_##X##_load(a + b + i + j); \
+                        sort_avx2_##X##_store(a + b + i, sort_avx2_##X##_min(x, y)); \
+                        sort_avx2_##X##_store(a + b + i + j, sort_avx2_##X##_max(x, y)); \
+                    } \
+                } \
+            } \
+        } \
+        /* Remaining steps stay inside one vector: do them all per load */ \
+        for (size_t i = 0; i < m; i += W) { \
+            V v = sort_avx2_##X##_load(a + i); \
+            if (k <= W) v = sort_avx2_##X##_flip(v, k); \
+            for (size_t jj = j; jj >= 1; jj >>= 1) v = sort_avx2_##X##_cx(v, jj); \
+            sort_avx2_##X##_store(a + i, v); \
+        } \
+    } \
+} \
+static SORT_AVX2 void sort_avx2_##X##_block(T* arr, size_t num) { \
+    T buf[SORT_SIMD_BUF]; \
+    size_t m = W; \
+    while (m < num) m <<= 1; \
+    memcpy(buf, arr, num * sizeof(T)); \
+    for (size_t i = num; i < m; i++) buf[i] = T_MAX; \
+    sort_avx2_##X##_network(buf, m); \
+    memcpy(arr, buf, num * sizeof(T)); \
+} \
+/* Moves elements < pivot (<= pivot if le) to the front; returns their count */ \
+static SORT_AVX2 size_t sort_avx2_##X##_partition(T* a, size_t n, T pivot, bool le) { \
+    if (n < 2 * W) { \
+        size_t k = 0; \
+        for (size_t i = 0; i < n; i++) { \
+            if (le ? !(pivot < a[i]) : a[i] < pivot) { \
+                T t = a[k]; a[k] = a[i]; a[i] = t; \
+                k++; \
+            } \
+        } \
+        return k; \
+    } \
+    V p = sort_avx2_##X##_set1(pivot); \
+    /* Buffer one vector from each end so every store lands in already-read space */ \
+    V vl = sort_avx2_##X##_load(a), vr = sort_avx2_##X##_load(a + n - W); \
+    size_t left = 0, right = n, rl = W, rr = n - W; \
+    while (rr - rl >= W) { \
+        V v; \
+        if (rl - left <= right - rr) { \
+            v = sort_avx2_##X##_load(a + rl); \
+            rl += W; \
+        } else { \
+            rr -= W; \
+            v = sort_avx2_##X##_load(a + rr); \
+        } \
+        unsigned mask = le ? sort_avx2_##X##_gtMask(v, p) : sort_avx2_##X##_geMask(v, p); \
+        V c = sort_avx2_##X##_compress(v, mask); \
+        size_t nl = W - (size_t)__builtin_popcount(mask); \
+        sort_avx2_##X##_store(a + left, c); \
+        sort_avx2_##X##_store(a + right - W, c); \
+        left += nl; \
+        right -= W - nl; \
+    } \
+    T rest[W]; \
+    size_t r = rr - rl; \
+    memcpy(rest, a + rl, r * sizeof(T)); \
+    for (size_t i = 0; i < r; i++) { \
+        if (le ? !(pivot < rest[i]) : rest[i] < pivot) a[left++] = rest[i]; \
+        else a[--right] = rest[i]; \
+    } \
+    V tail[2]; \
+    tail[0] = vl; \
+    tail[1] = vr; \
+    for (size_t i = 0; i < 2; i++) { \
+        unsigned mask = le ? sort_avx2_##X##_gtMask(tail[i], p) : sort_avx2_##X##_geMask(tail[i], p); \
+        V c = sort_avx2_##X##_compress(tail[i], mask); \
+        size_t nl = W - (size_t)__builtin_popcount(mask); \
+        sort_avx2_##X##_store(a + left, c); \
+        sort_avx2_##X##_store(a + right - W, c); \
+        left += nl; \
+        right -= W - nl; \
+    } \
+    return left; \
+} \
+static size_t sort_avx2_##X##_median3(const T* arr, size_t a, size_t b, size_t c) { \
+    if (arr[a] < arr[b]) { \
+        if (arr[b] < arr[c]) return b; \
+        return arr[a] < arr[c] ? c : a; \
+    } \
+    if (arr[a] < arr[c]) return a; \
+    return arr[b] < arr[c] ? c : b; \
+} \
+/* leftmost: arr[-1] does not exist; otherwise it is a previous pivot <= every element */ \
+static SORT_AVX2 void sort_avx2_##X##_quick(T* arr, size_t num, size_t depth_limit, bool leftmost) { \
+    while (num > SORT_SIMD_BLOCK) { \
+        if (depth_limit == 0) { \
+            HEAP(arr, num); \
+            return; \
+        } \
+        depth_limit--; \
+        size_t mid = num / 2, last = num - 1, step = num / 8; \
+        size_t p = sort_avx2_##X##_median3(arr, \
+            sort_avx2_##X##_median3(arr, 0, step, 2 * step), \
+            sort_avx2_##X##_median3(arr, mid - step, mid, mid + step), \
+            sort_avx2_##X##_median3(arr, last - 2 * step, last - step, last)); \
+        T pivot = arr[p]; arr[p] = arr[0]; arr[0] = pivot; \
+        if (!leftmost && !(arr[-1] < pivot)) { \
+            /* Pivot equals its predecessor: everything <= pivot is == pivot */ \
+            size_t k = sort_avx2_##X##_partition(arr + 1, num - 1, pivot, true) + 1; \
+            arr += k; \
+            num -= k; \
+            continue; \
+        } \
+        size_t k = sort_avx2_##X##_partition(arr + 1, num - 1, pivot, false); \
+        arr[0] = arr[k]; arr[k] = pivot; \
+        if (k < num - k - 1) { \
+            sort_avx2_##X##_quick(arr, k, depth_limit, leftmost); \
+            arr += k + 1; \
+            num -= k + 1; \
+            leftmost = false; \
+        } else { \
+            sort_avx2_##X##_quick(arr + k + 1, num - k - 1, depth_limit, false); \
+            num = k; \
+        } \
+    } \
+    if (num > 1) sort_avx2_##X##_block(arr, num); \
+} \
+static bool sort_avx2_##X##_sort(T* arr, size_t num) { \
+    if (!__builtin_cpu_supports("avx2")) return false; \
+    sort_avx2_##X##_quick(arr, num, 2 * sort_log2(num), true); \
+    return true; \
+}
+
+void heapSortInt(int* arr, size_t num);
+void heapSortFloat(float* arr, size_t num);
+void heapSortInt64(int64_t* arr, size_t num);
+SORT_AVX2_DEFINE_KERNELS(i32, int, 8, __m256i, INT_MAX, heapSortInt)
+SORT_AVX2_DEFINE_KERNELS(f32, float, 8, __m256, HUGE_VALF, heapSortFloat)
+SORT_AVX2_DEFINE_KERNELS(i64, int64_t, 4, __m256i, INT64_MAX, heapSortInt64)
+#define SORT_KERNEL_INT sort_avx2_i32_sort
+#define SORT_KERNEL_FLOAT sort_avx2_f32_sort
+#define SORT_KERNEL_INT64 sort_avx2_i64_sort
+#else
+#define SORT_KERNEL_INT SORT_NO_KERNEL
+#define SORT_KERNEL_FLOAT SORT_NO_KERNEL
+#define SORT_KERNEL_INT64 SORT_NO_KERNEL
+#endif
+
+//Type-specialized sorts
+//SORT_DEFINE_TYPED_SORTS(Name, T, LESS) generates insertionSort##Name,
+//heapSort##Name, quickSort##Name, mergeSort##Name and bitonicSort##Name for
+//arrays of T.
+//LESS(a, b) must be a strict weak ordering on values of T. The compiler sees
+//both the comparison and the element type, so compares are inlined and
+//elements move through registers instead of swap_bytes/memcpy.
+//The algorithms mirror the generic engines: quickSort##Name is an introsort,
+//mergeSort##Name is a stable merge sort with one num / 2 element buffer.
+//bitonicSort##Name runs the same network as bitonicSort with branch-free
+//compare-exchanges, so its sequence of memory accesses depends only on num.
+//SORT_DEFINE_TYPED_SORTS_EX additionally takes KERNEL(arr, num), which may
+//sort the whole array itself (returning true) before the scalar introsort runs.
+#define SORT_LESS(a, b) ((a) < (b))
+#define SORT_DEFINE_TYPED_SORTS(Name, T, LESS) SORT_DEFINE_TYPED_SORTS_EX(Name, T, LESS, SORT_NO_KERNEL)
+#define SORT_DEFINE_TYPED_SORTS_EX(Name, T, LESS, KERNEL) \
+void insertionSort##Name(T* arr, size_t num) { \
+    assert(arr != NULL && "Array cannot be NULL"); \
+    SORT_CALL_BEGIN("insertionSort" #Name, num); \
+    for (size_t i = 1; i < num; i++) { \
+        T key = arr[i]; \
+        size_t j = i; \
+        while (j > 0 && LESS(key, arr[j - 1])) { \
+            arr[j] = arr[j - 1]; \
+            j--; \
+        } \
+        arr[j] = key; \
+    } \
+    SORT_CALL_END(); \
+} \
+static void sort_##Name##_siftDown(T* arr, size_t n, size_t i) { \
+    T v = arr[i]; \
+    for (;;) { \
+        size_t child = 2 * i + 1; \
+        if (child >= n) break; \
+        if (child + 1 < n && LESS(arr[child], arr[child + 1])) child++; \
+        if (!LESS(v, arr[child])) break; \
+        arr[i] = arr[child]; \
+        i = child; \
+    } \
+    arr[i] = v; \
+} \
+void heapSort##Name(T* arr, size_t num) { \
+    assert(arr != NULL && "Array cannot be NULL"); \
+    SORT_CALL_BEGIN("heapSort" #Name, num); \
+    if (num <= 1) { SORT_CALL_END(); return; } \
+    for (size_t i = num / 2; i-- > 0;) sort_##Name##_siftDown(arr, num, i); \
+    for (size_t i = num - 1; i > 0; i--) { \
+        T t = arr[0]; arr[0] = arr[i]; arr[i] = t; \
+        sort_##Name##_siftDown(arr, i, 0); \
+    } \
+    SORT_CALL_END(); \
+} \
+static size_t sort_##Name##_median3(const T* arr, size_t a, size_t b, size_t c) { \
+    if (LESS(arr[a], arr[b])) { \
+        if (LESS(arr[b], arr[c])) return b; \
+        return LESS(arr[a], arr[c]) ? c : a; \
+    } \
+    if (LESS(arr[a], arr[c])) return a; \
+    return LESS(arr[b], arr[c]) ? c : b; \
+} \
+static void sort_##Name##_swapRange(T* a, T* b, size_t n) { \
+    for (size_t i = 0; i < n; i++) { T t = a[i]; a[i] = b[i]; b[i] = t; } \
+} \
+static void sort_##Name##_introLoop(T* arr, size_t num, size_t depth_limit) { \
+    while (num > SORT_INSERTION_THRESHOLD) { \
+        if (depth_limit == 0) { \
+            heapSort##Name(arr, num); \
+            return; \
+        } \
+        depth_limit--; \
+        size_t mid = num / 2, last = num - 1, p; \
+        if (num > SORT_NINTHER_THRESHOLD) { \
+            size_t step = num / 8; \
+            p = sort_##Name##_median3(arr, \
+                sort_##Name##_median3(arr, 0, step, 2 * step), \
+                sort_##Name##_median3(arr, mid - step, mid, mid + step), \
+                sort_##Name##_median3(arr, last - 2 * step, last - step, last)); \
+        } else { \
+            p = sort_##Name##_median3(arr, 0, mid, last); \
+        } \
+        T pivot = arr[p]; arr[p] = arr[0]; arr[0] = pivot; \
+        size_t a = 1, b = 1, c = num - 1, d = num - 1; \
+        for (;;) { \
+            while (b <= c && !LESS(pivot, arr[b])) { \
+                if (!LESS(arr[b], pivot)) { T t = arr[a]; arr[a] = arr[b]; arr[b] = t; a++; } \
+                b++; \
+            } \
+            while (b <= c && !LESS(arr[c], pivot)) { \
+                if (!LESS(pivot, arr[c])) { T t = arr[c]; arr[c] = arr[d]; arr[d] = t; d--; } \
+                c--; \
+            } \
+            if (b > c) break; \
+            T t = arr[b]; arr[b] = arr[c]; arr[c] = t; \
+            b++; c--; \
+        } \
+        size_t s = a < b - a ? a : b - a; \
+        sort_##Name##_swapRange(arr, arr + b - s, s); \
+        s = d - c < last - d ? d - c : last - d; \
+        sort_##Name##_swapRange(arr + b, arr + num - s, s); \
+        size_t lt = b - a, gt = d - c; \
+        if (lt < gt) { \
+            sort_##Name##_introLoop(arr, lt, depth_limit); \
+            arr += num - gt; \
+            num = gt; \
+        } else { \
+            sort_##Name##_introLoop(arr + num - gt, gt, depth_limit); \
+            num = lt; \
+        } \
+    } \
+    insertionSort##Name(arr, num); \
+} \
+void quickSort##Name(T* arr, size_t num) { \
+    assert(arr != NULL && "Array cannot be NULL"); \
+    SORT_CALL_BEGIN("quickSort" #Name, num); \
+    if (num <= 1) { SORT_CALL_END(); return; } \
+    if (KERNEL(arr, num)) { SORT_CALL_END(); return; } \
+    sort_##Name##_introLoop(arr, num, 2 * sort_log2(num)); \
+    SORT_CALL_END(); \
+} \
+static void sort_##Name##_mergeRec(T* arr, size_t num, T* tmp) { \
+    if (num <= 2 * SORT_INSERTION_THRESHOLD) { \
+        insertionSort##Name(arr, num); \
+        return; \
+    } \
+    size_t mid = num / 2; \
+    sort_##Name##_mergeRec(arr, mid, tmp); \
+    sort_##Name##_mergeRec(arr + mid, num - mid, tmp); \
+    if (!LESS(arr[mid], arr[mid - 1])) return; \
+    memcpy(tmp, arr, mid * sizeof(T)); \
+    size_t i = 0, j = mid, k = 0; \
+    while (i < mid && j < num) arr[k++] = LESS(arr[j], tmp[i]) ? arr[j++] : tmp[i++]; \
+    while (i < mid) arr[k++] = tmp[i++]; \
+} \
+void mergeSort##Name(T* arr, size_t num) { \
+    assert(arr != NULL && "Array cannot be NULL"); \
+    SORT_CALL_BEGIN("mergeSort" #Name, num); \
+    if (num <= 1) { SORT_CALL_END(); return; } \
+    T* tmp = (T*)SORT_MALLOC((num / 2) * sizeof(T)); \
+    if (!tmp) { sort_fail(SORT_ERROR_NO_MEMORY); SORT_CALL_END(); return; } \
+    sort_##Name##_mergeRec(arr, num, tmp); \
+    SORT_FREE(tmp); \
+    SORT_CALL_END(); \
+} \
+/* Bitonic network steps; compare-exchange is a branch-free min/max */ \
+static void sort_##Name##_bitonicFlip(T* arr, size_t num, size_t lo, size_t hi, size_t k) { \
+    for (size_t b = lo; b < hi && b < num; b += k) { \
+        T* x = arr + b; \
+        T* y = arr + b + k - 1; \
+        for (size_t i = b + k > num ? b + k - num : 0; i < k / 2; i++) { \
+            T u = x[i], v = *(y - i); \
+            x[i] = LESS(v, u) ? v : u; \
+            *(y - i) = LESS(v, u) ? u : v; \
+        } \
+    } \
+} \
+static void sort_##Name##_bitonicHalf(T* arr, size_t num, size_t lo, size_t hi, size_t j) { \
+    for (size_t b = lo; b < hi && b + j < num; b += 2 * j) { \
+        T* x = arr + b; \
+        T* y = arr + b + j; \
+        size_t n = b + 2 * j <= num ? j : num - j - b; \
+        for (size_t i = 0; i < n; i++) { \
+            T u = x[i], v = y[i]; \
+            x[i] = LESS(v, u) ? v : u; \
+            y[i] = LESS(v, u) ? u : v; \
+        } \
+    } \
+} \
+void bitonicSort##Name(T* arr, size_t num) { \
+    assert(arr != NULL && "Array cannot be NULL"); \
+    SORT_CALL_BEGIN("bitonicSort" #Name, num); \
+    if (num <= 1) { SORT_CALL_END(); return; } \
+    size_t m = 1; \
+    while (m < num) m *= 2; \
+    size_t block = bitonicBlockElems(sizeof(T), m); \
+    for (size_t lo = 0; lo < num; lo += block) { \
+        for (size_t k = 2; k <= block; k *= 2) { \
+            sort_##Name##_bitonicFlip(arr, num, lo, lo + block, k); \
+            for (size_t j = k / 4; j >= 1; j /= 2) sort_##Name##_bitonicHalf(arr, num, lo, lo + block, j); \
+        } \
+    } \
+    for (size_t k = block * 2; k <= m; k *= 2) { \
+        sort_##Name##_bitonicFlip(arr, num, 0, m, k); \
+        for (size_t j = k / 4; j >= block; j /= 2) sort_##Name##_bitonicHalf(arr, num, 0, m, j); \
+        for (size_t lo = 0; lo < num; lo += block) { \
+            for (size_t j = block / 2; j >= 1; j /= 2) sort_##Name##_bitonicHalf(arr, num, lo, lo + block, j); \
+        } \
+    } \
+    SORT_CALL_END(); \
+}
+
+//Float and double variants order by operator<, so arrays must not contain NaN
+SORT_DEFINE_TYPED_SORTS_EX(Int, int, SORT_LESS, SORT_KERNEL_INT)
+SORT_DEFINE_TYPED_SORTS_EX(Int64, int64_t, SORT_LESS, SORT_KERNEL_INT64)
+SORT_DEFINE_TYPED_SORTS(UInt32, uint32_t, SORT_LESS)
+SORT_DEFINE_TYPED_SORTS_EX(Float, float, SORT_LESS, SORT_KERNEL_FLOAT)
+SORT_DEFINE_TYPED_SORTS(Double, double, SORT_LESS)
+
+//20. Parallel Sort
+//Fork-join sorting on a work-stealing pool. Every worker owns a deque of
+//tasks: it pushes and pops its own work at the tail (LIFO, cache-warm) and
+//idle workers steal from the head of other deques, which holds the oldest
+//and therefore largest pieces. The calling thread is worker 0.
+//  parallelSort       - parallel introsort: partitions spawn one side as a task
+//  parallelMergeSort  - stable: timSort on chunks, then parallel merges that
+//                       split each merge by binary search (needs num elements
+//                       of scratch)
+//  parallelRadixSort* - MSD split on the highest varying digit with parallel
+//                       histograms and scatter, then LSD radix per bucket
+//  parallelCountingSort - per-thread dense histograms, parallel rewrite
+//  parallelBucketSort   - parallel classification and scatter into sample
+//                         sort buckets, then one task per bucket
+//nthreads == 0 uses every online CPU. Ranges below SORT_PARALLEL_GRAIN
+//elements are sorted sequentially.
+#ifndef SORT_PARALLEL_GRAIN
+#define SORT_PARALLEL_GRAIN 16384
+#endif
+
+#ifdef SORT_HAS_THREADS
+static size_t sortHardwareThreads(void) {
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0) return (size_t)n;
+#endif
+    return 1;
+}
+typedef struct sort_pool_s sort_pool;
+typedef struct sort_task_s {
+    void (*fn)(sort_pool* pool, size_t worker, const struct sort_task_s* task);
+    void* job;
+    size_t arg[5];
+} sort_task;
+typedef struct {
+    pthread_mutex_t lock;
+    sort_task* items;
+    size_t head, tail, cap;
+} sort_deque;
+typedef struct {
+    sort_pool* pool;
+    size_t worker;
+} sort_worker_arg;
+//Pool bookkeeping uses malloc/free directly: deques grow on worker threads,
+//which have no sort context, and are freed by the caller
+struct sort_pool_s {
+    size_t nworkers;
+    size_t nthreads; //background threads actually started
+    sort_deque* deques;
+    pthread_t* threads;
+    sort_worker_arg* args;
+    pthread_mutex_t lock;
+    pthread_cond_t cv;
+    size_t pending; //spawned tasks that have not finished
+    size_t queued; //spawned tasks still sitting in a deque
+    bool shutdown;
+    sort_status_t status; //first failure reported by a background thread
+#ifdef SORT_ENABLE_STATS
+    sort_stats_t stats; //counters gathered by the background threads
+#endif
+};
+static bool sort_dequePush(sort_deque* dq, const sort_task* task) {
+    if (dq->tail == dq->cap) {
+        if (dq->head > 0) {
+            memmove(dq->items, dq->items + dq->head, (dq->tail - dq->head) * sizeof(sort_task));
+            dq->tail -= dq->head;
+            dq->head = 0;
+        } else {
+            size_t cap = dq->cap ? dq->cap * 2 : 64;
+            sort_task* items = (sort_task*)realloc(dq->items, cap * sizeof(sort_task));
+            if (!items) return false;
+            dq->items = items;
+            dq->cap = cap;
+        }
+    }
+    dq->items[dq->tail++] = *task;
+    return true;
+}
+//Queues a task on the worker's own deque; runs it inline if the deque cannot grow
+static void sortPoolSpawn(sort_pool* pool, size_t worker, const sort_task* task) {
+    sort_deque* dq = &pool->deques[worker];
+    pthread_mutex_lock(&pool->lock);
+    pthread_mutex_lock(&dq->lock);
+    bool pushed = sort_dequePush(dq, task);
+    pthread_mutex_unlock(&dq->lock);
+    if (pushed) {
+        pool->pending++;
+        pool->queued++;
+        pthread_cond_signal(&pool->cv);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (!pushed) task->fn(pool, worker, task);
+}
+static bool sortPoolTake(sort_pool* pool, size_t worker, sort_task* out) {
+    for (size_t i = 0; i < pool->nworkers; i++) {
+        size_t victim = (worker + i) % pool->nworkers;
+        sort_deque* dq = &pool->deques[victim];
+        pthread_mutex_lock(&dq->lock);
+        bool got = dq->head < dq->tail;
+        if (got) *out = victim == worker ? dq->items[--dq->tail] : dq->items[dq->head++];
+        if (dq->head == dq->tail) dq->head = dq->tail = 0;
+        pthread_mutex_unlock(&dq->lock);
+        if (got) {
+            pthread_mutex_lock(&pool->lock);
+            pool->queued--;
+            pthread_mutex_unlock(&pool->lock);
+            return true;
+        }
+    }
+    return false;
+}
+//Runs tasks until every spawned task has finished (until_idle) or the pool shuts down
+static void sortPoolRun(sort_pool* pool, size_t worker, bool until_idle) {
+    sort_task task;
+    for (;;) {
+        if (sortPoolTake(pool, worker, &task)) {
+            task.fn(pool, worker, &task);
+            pthread_mutex_lock(&pool->lock);
+            if (--pool->pending == 0) pthread_cond_broadcast(&pool->cv);
+            pthread_mutex_unlock(&pool->lock);
+            continue;
+        }
+        pthread_mutex_lock(&pool->lock);
+        while (pool->queued == 0 && !(until_idle ? pool->pending == 0 : pool->shutdown)) {
+            pthread_cond_wait(&pool->cv, &pool->lock);
+        }
+        bool stop = pool->queued == 0;
+        pthread_mutex_unlock(&pool->lock);
+        if (stop) return;
+    }
+}
+static void* sort_poolThread(void* p) {
+    sort_worker_arg* arg = (sort_worker_arg*)p;
+    sort_call_nesting = 1; //sorts run by tasks belong to the caller's call
+    sortPoolRun(arg->pool, arg->worker, false);
+    pthread_mutex_lock(&arg->pool->lock);
+    if (arg->pool->status == SORT_OK) arg->pool->status = sort_last_status;
+#ifdef SORT_ENABLE_STATS
+    sort_statsMerge(&arg->pool->stats, &sort_stats_current);
+#endif
+    pthread_mutex_unlock(&arg->pool->lock);
+    return NULL;
+}
+static void sortPoolDestroy(sort_pool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->cv);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t i = 0; i < pool->nthreads; i++) pthread_join(pool->threads[i], NULL);
+    if (pool->status != SORT_OK) sort_fail(pool->status);
+#ifdef SORT_ENABLE_STATS
+    sort_statsMerge(&sort_stats_current, &pool->stats);
+#endif
+    for (size_t i = 0; i < pool->nworkers; i++) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].items);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->cv);
+    free(pool->deques);
+    free(pool->threads);
+    free(pool->args);
+}
+//Starts nworkers - 1 background threads; the caller acts as worker 0
+static bool sortPoolCreate(sort_pool* pool, size_t nworkers) {
+    memset(pool, 0, sizeof(*pool));
+    pool->deques = (sort_deque*)calloc(nworkers, sizeof(sort_deque));
+    pool->threads = (pthread_t*)calloc(nworkers, sizeof(pthread_t));
+    pool->args = (sort_worker_arg*)calloc(nworkers, sizeof(sort_worker_arg));
+    if (!pool->deques || !pool->threads || !pool->args) {
+        free(pool->deques); free(pool->threads); free(pool->args);
+        return false;
+    }
+    pool->nworkers = nworkers;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cv, NULL);
+    for (size_t i = 0; i < nworkers; i++) pthread_mutex_init(&pool->deques[i].lock, NULL);
+    for (size_t i = 1; i < nworkers; i++) {
+        pool->args[i].pool = pool;
+        pool->args[i].worker = i;
+        if (pthread_create(&pool->threads[pool->nthreads], NULL, sort_poolThread, &pool->args[i]) != 0) break;
+        pool->nthreads++;
+    }
+    if (pool->nthreads == 0) {
+        sortPoolDestroy(pool);
+        return false;
+    }
+    return true;
+}
+
+typedef struct {
+    unsigned char* arr;
+    unsigned char* src;
+    unsigned char* dst;
+    size_t size;
+    compare_func_t cmp;
+    size_t grain;
+} sort_parallel_job;
+//arg: lo, num, depth_limit
+static void sort_parallelQuickTask(sort_pool* pool, size_t worker, const sort_task* task) {
+    sort_parallel_job* job = (sort_parallel_job*)task->job;
+    size_t size = job->size;
+    size_t lo = task->arg[0], num = task->arg[1], depth_limit = task->arg[2];
+    while (num > job->grain) {
+        unsigned char* arr = job->arr + lo * size;
+        if (depth_limit == 0) {
+            heapSort(arr, num, size, job->cmp);
+            return;
+        }
+        depth_limit--;
+        size_t p = choosePivot(arr, num, size, job->cmp);
+        if (p != 0) swap_bytes(arr, arr + p * size, size);
+        size_t lt, gt;
+        partition(arr, num, size, job->cmp, &lt, &gt);
+        //Hand the larger side to the pool so thieves get big pieces
+        sort_task child = *task;
+        if (lt < gt) {
+            child.arg[0] = lo + num - gt; child.arg[1] = gt;
+            num = lt;
+        } else {
+            child.arg[0] = lo; child.arg[1] = lt;
+            lo += num - gt; num = gt;
+        }
+        child.arg[2] = depth_limit;
+        sortPoolSpawn(pool, worker, &child);
+    }
+    introSortLoop(job->arr + lo * size, num, size, job->cmp, depth_limit);
+}
+//arg: lo, num; sorts one chunk using the matching slice of the scratch buffer
+static void sort_parallelChunkTask(sort_pool* pool, size_t worker, const sort_task* task) {
+    (void)pool; (void)worker;
+    sort_parallel_job* job = (sort_parallel_job*)task->job;
+    size_t lo = task->arg[0], num = task->arg[1];
+    timSortWithBuffer(job->arr + lo * job->size, num, job->size, job->cmp, job->dst + lo * job->size, num * job->size);
+}
+//Stable merge of two sorted runs into a separate output
+static void sort_mergeInto(unsigned char* dst, const unsigned char* a, size_t na, const unsigned char* b, size_t nb, size_t size, compare_func_t cmp) {
+    SORT_STATS_MOVES(na + nb);
+    while (na > 0 && nb > 0) {
+        if (SORT_CMP(cmp, b, a) < 0) {
+            memcpy(dst, b, size);
+            b += size; nb--;
+        } else {
+            memcpy(dst, a, size);
+            a += size; na--;
+        }
+        dst += size;
+    }
+    memcpy(dst, a, na * size);
+    memcpy(dst + na * size, b, nb * size);
+}
+//First index in run[0, n) whose element is not less than key (upper: greater than key)
+static size_t sort_searchRun(const unsigned char* run, size_t n, const void* key, size_t size, compare_func_t cmp, bool upper) {
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int r = SORT_CMP(cmp, run + mid * size, key);
+        if (r < 0 || (upper && r == 0)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+//arg: a_lo, a_n, b_lo, b_n, dst_lo; merges job->src runs into job->dst,
+//splitting off the upper half of large merges as new tasks
+static void sort_parallelMergeTask(sort_pool* pool, size_t worker, const sort_task* task) {
+    sort_parallel_job* job = (sort_parallel_job*)task->job;
+    size_t size = job->size;
+    size_t a_lo = task->arg[0], a_n = task->arg[1], b_lo = task->arg[2], b_n = task->arg[3], d_lo = task->arg[4];
+    const unsigned char* src = job->src;
+    while (a_n > 0 && b_n > 0 && a_n + b_n > job->grain) {
+        size_t ma, mb;
+        if (a_n >= b_n) {
+            ma = a_n / 2;
+            mb = sort_searchRun(src + b_lo * size, b_n, src + (a_lo + ma) * size, size, job->cmp, false);
+        } else {
+            mb = b_n / 2;
+            ma = sort_searchRun(src + a_lo * size, a_n, src + (b_lo + mb) * size, size, job->cmp, true);
+        }
+        sort_task child = *task;
+        child.arg[0] = a_lo + ma; child.arg[1] = a_n - ma;
+        child.arg[2] = b_lo + mb; child.arg[3] = b_n - mb;
+        child.arg[4] = d_lo + ma + mb;
+        sortPoolSpawn(pool, worker, &child);
+        a_n = ma;
+        b_n = mb;
+    }
+    sort_mergeInto(job->dst + d_lo * size, src + a_lo * size, a_n, src + b_lo * size, b_n, size, job->cmp);
+}
+static void sort_spawnMerge(sort_pool* pool, sort_parallel_job* job, size_t a_lo, size_t a_n, size_t b_lo, size_t b_n, size_t d_lo) {
+    sort_task t;
+    t.fn = sort_parallelMergeTask;
+    t.job = job;
+    t.arg[0] = a_lo; t.arg[1] = a_n; t.arg[2] = b_lo; t.arg[3] = b_n; t.arg[4] = d_lo;
+    sortPoolSpawn(pool, 0, &t);
+}
+#endif
+
+void parallelSort(void* base, size_t num, size_t size, compare_func_t cmp, size_t nthreads) {
+    assert(base != NULL && "Array cannot be NULL");
+    assert(cmp != NULL && "Comparison function cannot be NULL");
+    SORT_CALL_BEGIN("parallelSort", num);
+    if (num <= 1) { SORT_CALL_END(); return; }
+#ifdef SORT_HAS_THREADS
+    if (nthreads == 0) nthreads = sortHardwareThreads();
+    sort_pool pool;
+    if (nthreads > 1 && num > SORT_PARALLEL_GRAIN && sortPoolCreate(&pool, nthreads)) {
+        sort_parallel_job job = {(unsigned char*)base, NULL, NULL, size, cmp, SORT_PARALLEL_GRAIN};
+        sort_task t;
+        t.fn = sort_parallelQuickTask;
+        t.job = &job;
+        t.arg[0] = 0; t.arg[1] = num; t.arg[2] = 2 * sort_log2(num);
+        sortPoolSpawn(&pool, 0, &t);
+        sortPoolRun(&pool, 0, true);
+        sortPoolDestroy(&pool);
+        SORT_CALL_END();
+        return;
+    }
+#else
+    (void)nthreads;
+#endif
+    introSort(base, num, size, cmp);
+    SORT_CALL_END();
+}
+
+void parallelMergeSort(void* base, size_t num, size_t size, compare_func_t cmp, size_t nthreads) {
+    assert(base != NULL && "Array cannot be NULL");
+    assert(cmp != NULL && "Comparison function cannot be NULL");
+    SORT_CALL_BEGIN("parallelMergeSort", num);
+    if (num <= 1) { SORT_CALL_END(); return; }
+#ifdef SORT_HAS_THREADS
+    if (nthreads == 0) nthreads = sortHardwareThreads();
+    unsigned char* buf = NULL;
+    sort_pool pool;
+    if (nthreads > 1 && num > SORT_PARALLEL_GRAIN && (buf = (unsigned char*)SORT_MALLOC(num * size)) != NULL) {
+        if (!sortPoolCreate(&pool, nthreads)) {
+            SORT_FREE(buf);
+            timSort(base, num, size, cmp);
+            SORT_CALL_END();
+            return;
+        }
+        sort_parallel_job job = {(unsigned char*)base, (unsigned char*)base, buf, size, cmp, SORT_PARALLEL_GRAIN};
+        size_t nchunks = pool.nworkers * 4;
+        if (nchunks > num / SORT_PARALLEL_GRAIN) nchunks = num / SORT_PARALLEL_GRAIN;
+        if (nchunks == 0) nchunks = 1;
+        size_t width = (num + nchunks - 1) / nchunks;
+        for (size_t lo = 0; lo < num; lo += width) {
+            sort_task t;
+            t.fn = sort_parallelChunkTask;
+            t.job = &job;
+            t.arg[0] = lo;
+            t.arg[1] = num - lo < width ? num - lo : width;
+            sortPoolSpawn(&pool, 0, &t);
+        }
+        sortPoolRun(&pool, 0, true);
+        for (; width < num; width *= 2) {
+            for (size_t lo = 0; lo < num; lo += 2 * width) {
+                size_t a_n = num - lo < width ? num - lo : width;
+                size_t b_n = num - lo - a_n < width ? num - lo - a_n : width;
+                sort_spawnMerge(&pool, &job, lo, a_n, lo + a_n, b_n, lo);
+            }
+            sortPoolRun(&pool, 0, true);
+            unsigned char* t = job.src; job.src = job.dst; job.dst = t;
+        }
+        if (job.src != job.arr) {
+            job.dst = job.arr;
+            for (size_t lo = 0; lo < num; lo += SORT_PARALLEL_GRAIN * 4) {
+                size_t n = num - lo < SORT_PARALLEL_GRAIN * 4 ? num - lo : SORT_PARALLEL_GRAIN * 4;
+                sort_spawnMerge(&pool, &job, lo, n, 0, 0, lo);
+            }
+            sortPoolRun(&pool, 0, true);
+        }
+        sortPoolDestroy(&pool);
+        SORT_FREE(buf);
+        SORT_CALL_END();
+        return;
+    }
+#else
+    (void)nthreads;
+#endif
+    timSort(base, num, size, cmp);
+    SORT_CALL_END();
+}
+
+//SORT_DEFINE_PARALLEL_RADIX_SORT(Name, T, U) adds parallelRadixSort##Name on
+//top of the SORT_DEFINE_RADIX_SORT instantiation with the same Name
+#ifdef SORT_HAS_THREADS
+#define SORT_DEFINE_PARALLEL_RADIX_SORT(Name, T, U) \
+typedef struct { \
+    T* arr; \
+    T* scratch; \
+    size_t num, chunk, nchunks, digit; \
+    size_t* counts; /* nchunks x sizeof(U) x SORT_RADIX_BUCKETS */ \
+    size_t bucket_start[SORT_RADIX_BUCKETS + 1]; \
+} sort_pradix_##Name##_job; \
+static void sort_pradix_##Name##_histTask(sort_pool* pool, size_t worker, const sort_task* task) { \
+    (void)pool; (void)worker; \
+    sort_pradix_##Name##_job* job = (sort_pradix_##Name##_job*)task->job; \
+    size_t c = task->arg[0]; \
+    size_t lo = c * job->chunk, hi = lo + job->chunk < job->num ? lo + job->chunk : job->num; \
+    size_t* counts = job->counts + c * sizeof(U) * SORT_RADIX_BUCKETS; \
+    for (size_t i = lo; i < hi; i++) { \
+        U k = sort_radix_##Name##_key(job->arr + i); \
+        for (size_t p = 0; p < sizeof(U); p++) { \
+            counts[p * SORT_RADIX_BUCKETS + ((k >> (p * SORT_RADIX_BITS)) & (SORT_RADIX_BUCKETS - 1))]++; \
+        } \
+    } \
+} \
+static void sort_pradix_##Name##_scatterTask(sort_pool* pool, size_t worker, const sort_task* task) { \
+    (void)pool; (void)worker; \
+    sort_pradix_##Name##_job* job = (sort_pradix_##Name##_job*)task->job; \
+    size_t c = task->arg[0]; \
+    size_t lo = c * job->chunk, hi = lo + job->chunk < job->num ? lo + job->chunk : job->num; \
+    size_t* offsets = job->counts + (c * sizeof(U) + job->digit) * SORT_RADIX_BUCKETS; \
+    size_t shift = job->digit * SORT_RADIX_BITS; \
+    for (size_t i = lo; i < hi; i++) { \
+        job->scratch[offsets[(sort_radix_##Name##_key(job->arr + i) >> shift) & (SORT_RADIX_BUCKETS - 1)]++] = job->arr[i]; \
+    } \
+} \
+static void sort_pradix_##Name##_bucketTask(sort_pool* pool, size_t worker, const sort_task* task) { \
+    (void)pool; (void)worker; \
+    sort_pradix_##Name##_job* job = (sort_pradix_##Name##_job*)task->job; \
+    size_t lo = job->bucket_start[task->arg[0]], n = job->bucket_start[task->arg[0] + 1] - lo; \
+    sort_radix_##Name##_run(job->scratch + lo, job->arr + lo, NULL, NULL, 0, n); \
+    memcpy(job->arr + lo, job->scratch + lo, n * sizeof(T)); \
+} \
+void parallelRadixSort##Name(T* arr, size_t num, size_t nthreads) { \
+    assert(arr != NULL && "Array cannot be NULL"); \
+    SORT_CALL_BEGIN("parallelRadixSort" #Name, num); \
+    if (num <= 1) { SORT_CALL_END(); return; } \
+    if (nthreads == 0) nthreads = sortHardwareThreads(); \
+    if (nthreads <= 1 || num <= SORT_PARALLEL_GRAIN) { \
+        radixSort##Name(arr, num); \
+        SORT_CALL_END(); \
+        return; \
+    } \
+    sort_pradix_##Name##_job job; \
+    job.arr = arr; \
+    job.num = num; \
+    job.nchunks = nthreads * 4; \
+    if (job.nchunks > num / SORT_PARALLEL_GRAIN) job.nchunks = num / SORT_PARALLEL_GRAIN; \
+    if (job.nchunks == 0) job.nchunks = 1; \
+    job.chunk = (num + job.nchunks - 1) / job.nchunks; \
+    job.nchunks = (num + job.chunk - 1) / job.chunk; \
+    job.scratch = (T*)SORT_MALLOC(num * sizeof(T)); \
+    job.counts = (size_t*)SORT_CALLOC(job.nchunks * sizeof(U) * SORT_RADIX_BUCKETS, sizeof(size_t)); \
+    sort_pool pool; \
+    if (!job.scratch || !job.counts || !sortPoolCreate(&pool, nthreads)) { \
+        SORT_FREE(job.scratch); SORT_FREE(job.counts); \
+        radixSort##Name(arr, num); \
+        SORT_CALL_END(); \
+        return; \
+    } \
+    sort_task t; \
+    t.job = &job; \
+    t.fn = sort_pradix_##Name##_histTask; \
+    for (size_t c = 0; c < job.nchunks; c++) { t.arg[0] = c; sortPoolSpawn(&pool, 0, &t); } \
+    sortPoolRun(&pool, 0, true); \
+    /* Split on the most significant digit that actually varies */ \
+    size_t digit = sizeof(U); \
+    while (digit > 0) { \
+        digit--; \
+        size_t used = 0; \
+        for (size_t b = 0; b < SORT_RADIX_BUCKETS && used < 2; b++) { \
+            size_t total = 0; \
+            for (size_t c = 0; c < job.nchunks; c++) total += job.counts[(c * sizeof(U) + digit) * SORT_RADIX_BUCKETS + b]; \
+            if (total) used++; \
+        } \
+        if (used > 1) break; \
+        if (digit == 0) { digit = sizeof(U); break; } \
+    } \
+    if (digit < sizeof(U)) { \
+        job.digit = digit; \
+        size_t sum = 0; \
+        for (size_t b = 0; b < SORT_RADIX_BUCKETS; b++) { \
+            job.bucket_start[b] = sum; \
+            for (size_t c = 0; c < job.nchunks; c++) { \
+                size_t* cnt = &job.counts[(c * sizeof(U) + digit) * SORT_RADIX_BUCKETS + b]; \
+                size_t v = *cnt; \
+                *cnt = sum; \
+                sum += v; \
+            } \
+        } \
+        job.bucket_start[SORT_RADIX_BUCKETS] = sum; \
+        t.fn = sort_pradix_##Name##_scatterTask; \
+        for (size_t c = 0; c < job.nchunks; c++) { t.arg[0] = c; sortPoolSpawn(&pool, 0, &t); } \
+        sortPoolRun(&pool, 0, true); \
+        t.fn = sort_pradix_##Name##_bucketTask; \
+        for (size_t b = 0; b < SORT_RADIX_BUCKETS; b++) { \
+            if (job.bucket_start[b + 1] == job.bucket_start[b]) continue; \
+            t.arg[0] = b; \
+            sortPoolSpawn(&pool, 0, &t); \
+        } \
+        sortPoolRun(&pool, 0, true); \
+    } \
+    sortPoolDestroy(&pool); \
+    SORT_FREE(job.scratch); \
+    SORT_FREE(job.counts); \
+    SORT_CALL_END(); \
+}
+#else
+#define SORT_DEFINE_PARALLEL_RADIX_SORT(Name, T, U) \
+void parallelRadixSort##Name(T* arr, size_t num, size_t nthreads) { \
+    SORT_CALL_BEGIN("parallelRadixSort" #Name, num); \
+    (void)nthreads; \
+    radixSort##Name(arr, num); \
+    SORT_CALL_END(); \
+}
+#endif
+
+SORT_DEFINE_PARALLEL_RADIX_SORT(Int, int, unsigned int)
+SORT_DEFINE_PARALLEL_RADIX_SORT(Int32, int32_t, uint32_t)
+SORT_DEFINE_PARALLEL_RADIX_SORT(UInt32, uint32_t, uint32_t)
+SORT_DEFINE_PARALLEL_RADIX_SORT(Int64, int64_t, uint64_t)
+SORT_DEFINE_PARALLEL_RADIX_SORT(UInt64, uint64_t, uint64_t)
+SORT_DEFINE_PARALLEL_RADIX_SORT(Float, float, uint32_t)
+SORT_DEFINE_PARALLEL_RADIX_SORT(Double, double, uint64_t)
+
+//parallelCountingSort: each worker counts its slice into a private dense
+//histogram whose rows are padded to SORT_CACHE_LINE bytes, so no two workers
+//write the same line. The rows are summed by key range and the output is
+//rewritten in key ranges that hold equal shares of the elements. Wide or
+//sparse ranges use the sequential countingSort engine.
+#ifndef SORT_CACHE_LINE
+#define SORT_CACHE_LINE 64
+#endif
+#ifdef SORT_HAS_THREADS
+//First cache-line boundary in a block allocated with one spare line
+static size_t* sort_alignLine(void* raw) {
+    return (size_t*)(((uintptr_t)raw + SORT_CACHE_LINE - 1) & ~(uintptr_t)(SORT_CACHE_LINE - 1));
+}
+typedef struct {
+    int* arr;
+    size_t num, chunk, nchunks, stride;
+    int min_val;
+    size_t* counts; // nchunks rows of stride counters; row 0 ends up as the total
+} sort_pcount_job;
+//arg: chunk
+static void sort_pcountHistTask(sort_pool* pool, size_t worker, const sort_task* task) {
+    (void)pool; (void)worker;
+    sort_pcount_job* job = (sort_pcount_job*)task->job;
+    size_t c = task->arg[0];
+    size_t lo = c * job->chunk, hi = lo + job->chunk < job->num ? lo + job->chunk : job->num;
+    size_t* count = job->counts + c * job->stride;
+    for (size_t i = lo; i < hi; i++) count[(uint32_t)job->arr[i] - (uint32_t)job->min_val]++;
+}
+//arg: first key, end key
+static void sort_pcountSumTask(sort_pool* pool, size_t worker, const sort_task* task) {
+    (void)pool; (void)worker;
+    sort_pcount_job* job = (sort_pcount_job*)task->job;
+    for (size_t c = 1; c < job->nchunks; c++) {
+        const size_t* row = job->counts + c * job->stride;
+        for (size_t j = task->arg[0]; j < task->arg[1]; j++) job->counts[j] += row[j];
+    }
+}
+//arg: first key, end key, output position
+static void sort_pcountFillTask(sort_pool* pool, size_t worker, const sort_task* task) {
+    (void)pool; (void)worker;
+    sort_pcount_job* job = (sort_pcount_job*)task->job;
+    int* out = job->arr + task->arg[2];
+    for (size_t j = task->arg[0]; j < task->arg[1]; j++) {
+        int key = (int)((int64_t)job->min_val + (int64_t)j);
+        for (size_t c = job->counts[j]; c > 0; c--) *out++ = key;
+    }
+}
+void parallelCountingSort(int arr[], size_t n, size_t nthreads) {
+    assert(arr != NULL && "Array cannot be NULL");
+    SORT_CALL_BEGIN("parallelCountingSort", n);
+    if (n <= 1) { SORT_CALL_END(); return; }
+    if (nthreads == 0) nthreads = sortHardwareThreads();
+    sort_pcount_job job;
+    uint64_t range;
+    sort_countRange(arr, n, &job.min_val, &range);
+    size_t line = SORT_CACHE_LINE / sizeof(size_t);
+    job.stride = (size_t)((range + line - 1) / line * line);
+    job.nchunks = nthreads < n / SORT_PARALLEL_GRAIN ? nthreads : n / SORT_PARALLEL_GRAIN;
+    while (job.nchunks > 1 && job.nchunks * job.stride > SORT_COUNTING_MAX_BYTES / sizeof(size_t)) job.nchunks--;
+    if (job.nchunks <= 1 || range == 1 || !sort_countDense(range, n)) {
+        sort_countingRun(arr, NULL, n, 0);
+        SORT_CALL_END();
+        return;
+    }
+    job.arr = arr;
+    job.num = n;
+    job.chunk = (n + job.nchunks - 1) / job.nchunks;
+    job.nchunks = (n + job.chunk - 1) / job.chunk;
+    void* raw = SORT_CALLOC(job.nchunks * job.stride + line, sizeof(size_t));
+    sort_pool pool;
+    if (!raw || !sortPoolCreate(&pool, nthreads)) {
+        SORT_FREE(raw);
+        sort_countingRun(arr, NULL, n, 0);
+        SORT_CALL_END();
+        return;
+    }
+    job.counts = sort_alignLine(raw);
+    sort_task t;
+    t.job = &job;
+    t.fn = sort_pcountHistTask;
+    for (size_t c = 0; c < job.nchunks; c++) { t.arg[0] = c; sortPoolSpawn(&pool, 0, &t); }
+    sortPoolRun(&pool, 0, true);
+    size_t parts = nthreads * 4, keys = (size_t)range;
+    t.fn = sort_pcountSumTask;
+    for (size_t p = 0; p < parts; p++) {
+        t.arg[0] = keys * p / parts / line * line;
+        t.arg[1] = p + 1 == parts ? keys : keys * (p + 1) / parts / line * line;
+        if (t.arg[0] < t.arg[1]) sortPoolSpawn(&pool, 0, &t);
+    }
+    sortPoolRun(&pool, 0, true);
+    //Cut the key range where the running total passes each share of n
+    t.fn = sort_pcountFillTask;
+    size_t first = 0, pos = 0, sum = 0;
+    for (size_t j = 0; j < keys; j++) {
+        sum += job.counts[j];
+        if (sum - pos >= n / parts || j + 1 == keys) {
+            t.arg[0] = first; t.arg[1] = j + 1; t.arg[2] = pos;
+            sortPoolSpawn(&pool, 0, &t);
+            first = j + 1;
+            pos = sum;
+        }
+    }
+    sortPoolRun(&pool, 0, true);
+    SORT_STATS_MOVES(n);
+    sortPoolDestroy(&pool);
+    SORT_FREE(raw);
+    SORT_CALL_END();
+}
+#else
+void parallelCountingSort(int arr[], size_t n, size_t nthreads) {
+    SORT_CALL_BEGIN("parallelCountingSort", n);
+    (void)nthreads;
+    countingSort(arr, n);
+    SORT_CALL_END();
+}
+#endif
+
+//parallelBucketSort: workers classify chunks into per-chunk bucket counts
+//(rows padded to SORT_CACHE_LINE), scatter them into the shared slab at
+//prefix-summed offsets, and then finish the buckets as independent tasks
+#ifdef SORT_HAS_THREADS
+typedef struct {
+    int* arr;
+    int* scratch;
+    unsigned char* oracle;
+    size_t num, chunk, nchunks, stride;
+    size_t* counts; // nchunks rows of stride counters, then output offsets
+    size_t start[SORT_BUCKET_MAX + 1];
+    sort_bucket_splitters sp;
+} sort_pbucket_job;
+//arg: chunk
+static void sort_pbucketClassifyTask(sort_pool* pool, size_t worker, const sort_task* task) {
+    (void)pool; (void)worker;
+    sort_pbucket_job* job = (sort_pbucket_job*)task->job;
+    size_t c = task->arg[0];
+    size_t lo = c * job->chunk, hi = lo + job->chunk < job->num ? lo + job->chunk : job->num;
+    sort_bucketClassify(&job->sp, job->arr + lo, job->oracle + lo, hi - lo, job->counts + c * job->stride);
+}
+//arg: chunk
+static void sort_pbucketScatterTask(sort_pool* pool, size_t worker, const sort_task* task) {
+    (void)pool; (void)worker;
+    sort_pbucket_job* job = (sort_pbucket_job*)task->job;
+    size_t c = task->arg[0];
+    size_t lo = c * job->chunk, hi = lo + job->chunk < job->num ? lo + job->chunk : job->num;
+    size_t* offset = job->counts + c * job->stride;
+    for (size_t i = lo; i < hi; i++) job->scratch[offset[job->oracle[i]]++] = job->arr[i];
+}
+//arg: bucket
+static void sort_pbucketFinishTask(sort_pool* pool, size_t worker, const sort_task* task) {
+    (void)pool; (void)worker;
+    sort_pbucket_job* job = (sort_pbucket_job*)task->job;
+    size_t lo = job->start[task->arg[0]], count = job->start[task->arg[0] + 1] - lo;
+    memcpy(job->arr + lo, job->scratch + lo, count * sizeof(int));
+    if (count > job->num / 2) quickSortInt(job->arr + lo, count);
+    else sort_bucketRun(job->arr + lo, job->scratch + lo, job->oracle + lo, count, 1);
+}
+void parallelBucketSort(int arr[], size_t n, size_t nthreads) {
+    assert(arr != NULL && "Array cannot be NULL");
+    SORT_CALL_BEGIN("parallelBucketSort", n);
+    if (n <= 1) { SORT_CALL_END(); return; }
+    if (nthreads == 0) nthreads = sortHardwareThreads();
+    size_t buckets = sort_bucketCount(n);
+    sort_pbucket_job job;
+    if (buckets > 0) {
+        //Enough buckets that every worker gets several to finish
+        while (buckets < SORT_BUCKET_MAX && buckets < nthreads * 4) buckets *= 2;
+    }
+    if (nthreads <= 1 || n <= SORT_PARALLEL_GRAIN || buckets == 0 || !sort_bucketSample(&job.sp, arr, n, buckets)) {
+        bucketSort(arr, n);
+        SORT_CALL_END();
+        return;
+    }
+    job.arr = arr;
+    job.num = n;
+    job.nchunks = nthreads * 4 < n / SORT_PARALLEL_GRAIN ? nthreads * 4 : n / SORT_PARALLEL_GRAIN;
+    job.chunk = (n + job.nchunks - 1) / job.nchunks;
+    job.nchunks = (n + job.chunk - 1) / job.chunk;
+    size_t line = SORT_CACHE_LINE / sizeof(size_t);
+    job.stride = (buckets + line - 1) / line * line;
+    unsigned char* slab = (unsigned char*)SORT_MALLOC(n * (sizeof(int) + 1));
+    void* raw = SORT_CALLOC(job.nchunks * job.stride + line, sizeof(size_t));
+    sort_pool pool;
+    if (!slab || !raw || !sortPoolCreate(&pool, nthreads)) {
+        SORT_FREE(raw); SORT_FREE(slab);
+        bucketSort(arr, n);
+        SORT_CALL_END();
+        return;
+    }
+    job.scratch = (int*)slab;
+    job.oracle = slab + n * sizeof(int);
+    job.counts = sort_alignLine(raw);
+    sort_task t;
+    t.job = &job;
+    t.fn = sort_pbucketClassifyTask;
+    for (size_t c = 0; c < job.nchunks; c++) { t.arg[0] = c; sortPoolSpawn(&pool, 0, &t); }
+    sortPoolRun(&pool, 0, true);
+    size_t sum = 0;
+    for (size_t b = 0; b < buckets; b++) {
+        job.start[b] = sum;
+        for (size_t c = 0; c < job.nchunks; c++) {
+            size_t* cnt = &job.counts[c * job.stride + b];
+            size_t v = *cnt;
+            *cnt = sum;
+            sum += v;
+        }
+    }
+    job.start[buckets] = sum;
+    t.fn = sort_pbucketScatterTask;
+    for (size_t c = 0; c < job.nchunks; c++) { t.arg[0] = c; sortPoolSpawn(&pool, 0, &t); }
+    sortPoolRun(&pool, 0, true);
+    t.fn = sort_pbucketFinishTask;
+    for (size_t b = 0; b < buckets; b++) {
+        if (job.start[b + 1] == job.start[b]) continue;
+        t.arg[0] = b;
+        sortPoolSpawn(&pool, 0, &t);
+    }
+    sortPoolRun(&pool, 0, true);
+    SORT_STATS_MOVES(2 * n);
+    sortPoolDestroy(&pool);
+    SORT_FREE(raw);
+    SORT_FREE(slab);
+    SORT_CALL_END();
+}
+#else
+void parallelBucketSort(int arr[], size_t n, size_t nthreads) {
+    SORT_CALL_BEGIN("parallelBucketSort", n);
+    (void)nthreads;
+    bucketSort(arr, n);
+    SORT_CALL_END();
+}
+#endif
+
+//21. External Sort
+//Sorts a file of fixed-size binary records that may be much larger than RAM.
+//The input is read in chunks that fit the memory budget, each chunk is
+//sorted with introSort and spilled as a run, and the runs are combined with
+//a loser-tree k-way merge (several passes if there are more runs than the
+//budget allows buffers for). With threads the next chunk is read while the
+//current one is sorted and written. All I/O is large sequential reads and
+//writes through the library's own buffers. Runs are unlinked temporary
+//files created in temp_dir (NULL for the system default). Not stable.
+//Without POSIX I/O (see SORT_HAS_POSIX_IO) temp_dir is ignored in favour of
+//tmpfile() and spill files are limited to LONG_MAX bytes.
+//Returns SORT_OK, SORT_ERROR_IO or SORT_ERROR_NO_MEMORY.
+#ifndef SORT_EXTERNAL_MIN_BUFFER
+#define SORT_EXTERNAL_MIN_BUFFER (64 * 1024)
+#endif
+//Tournament tree over k sources; ties go to the lower source index
+typedef struct {
+    size_t k;
+    size_t* tree; //tree[0] is the winner, tree[1, k) hold the losers
+    const unsigned char** heads; //current element of each source, NULL once exhausted
+    compare_func_t cmp;
+} sort_loser_tree;
+static bool sort_loserBeats(const sort_loser_tree* lt, size_t a, size_t b) {
+    const unsigned char* x = lt->heads[a];
+    const unsigned char* y = lt->heads[b];
+    if (!x || !y) return y == NULL && (x != NULL || a < b);
+    int r = SORT_CMP(lt->cmp, x, y);
+    return r < 0 || (r == 0 && a < b);
+}
+static size_t sort_loserBuild(sort_loser_tree* lt, size_t node) {
+    if (node >= lt->k) return node - lt->k;
+    size_t a = sort_loserBuild(lt, 2 * node);
+    size_t b = sort_loserBuild(lt, 2 * node + 1);
+    if (sort_loserBeats(lt, a, b)) {
+        lt->tree[node] = b;
+        return a;
+    }
+    lt->tree[node] = a;
+    return b;
+}
+static void sort_loserInit(sort_loser_tree* lt) {
+    lt->tree[0] = lt->k > 1 ? sort_loserBuild(lt, 1) : 0;
+}
+//Call after heads[tree[0]] has advanced; replays the winner's path to the root
+static void sort_loserReplay(sort_loser_tree* lt) {
+    size_t w = lt->tree[0];
+    for (size_t node = (w + lt->k) / 2; node >= 1; node /= 2) {
+        if (sort_loserBeats(lt, lt->tree[node], w)) {
+            size_t t = lt->tree[node];
+            lt->tree[node] = w;
+            w = t;
+        }
+    }
+    lt->tree[0] = w;
+}
+
+//A run is a byte range of a spill file; a source streams one run through a buffer
+typedef struct {
+    uint64_t offset;
+    uint64_t bytes;
+} sort_ext_run;
+typedef struct {
+    FILE* f;
+    uint64_t offset; //next byte of the run still on disk
+    uint64_t left; //bytes of the run still on disk
+    unsigned char* buf;
+    size_t cap, len, pos; //bytes
+} sort_ext_source;
+static FILE* sort_extTempFile(const char* temp_dir) {
+#if defined(SORT_HAS_POSIX_IO)
+    if (temp_dir != NULL) {
+        size_t n = strlen(temp_dir);
+        char* path = (char*)SORT_MALLOC(n + 32);
+        if (!path) return NULL;
+        memcpy(path, temp_dir, n);
+        strcpy(path + n, "/sortinc-run-XXXXXX");
+        int fd = mkstemp(path);
+        FILE* f = NULL;
+        if (fd >= 0) {
+            unlink(path);
+            f = fdopen(fd, "w+b");
+            if (!f) close(fd);
+        }
+        SORT_FREE(path);
+        if (f) setvbuf(f, NULL, _IONBF, 0);
+        return f;
+    }
+#else
+    (void)temp_dir;
+#endif
+    FILE* f = tmpfile();
+    if (f) setvbuf(f, NULL, _IONBF, 0);
+    return f;
+}
+static bool sort_extSeek(FILE* f, uint64_t offset) {
+#if defined(_WIN32)
+    return _fseeki64(f, (__int64)offset, SEEK_SET) == 0;
+#elif defined(SORT_HAS_POSIX_IO)
+    return fseeko(f, (off_t)offset, SEEK_SET) == 0;
+#else
+    if (offset > (uint64_t)LONG_MAX) return false;
+    return fseek(f, (long)offset, SEEK_SET) == 0;
+#endif
+}
+static bool sort_extWrite(FILE* f, const void* data, size_t bytes) {
+    return fwrite(data, 1, bytes, f) == bytes;
+}
+static bool sort_extRefill(sort_ext_source* s, size_t record_size) {
+    size_t want = s->left < s->cap ? (size_t)s->left : s->cap;
+    s->pos = 0;
+    s->len = 0;
+    if (want == 0) return true;
+    if (!sort_extSeek(s->f, s->offset)) return false;
+    s->len = fread(s->buf, 1, want, s->f);
+    s->offset += s->len;
+    s->left -= s->len;
+    return s->len == want && s->len % record_size == 0;
+}
+//Merges the sources into out with a loser tree; out_buf stages the output
+static bool sort_extMerge(sort_ext_source* src, size_t k, FILE* out, unsigned char* out_buf, size_t out_cap, size_t record_size, compare_func_t cmp) {
+    sort_loser_tree lt;
+    lt.k = k;
+    lt.cmp = cmp;
+    lt.tree = (size_t*)SORT_MALLOC(k * sizeof(size_t));
+    lt.heads = (const unsigned char**)SORT_MALLOC(k * sizeof(unsigned char*));
+    bool ok = lt.tree != NULL && lt.heads != NULL;
+    for (size_t i = 0; ok && i < k; i++) {
+        ok = sort_extRefill(&src[i], record_size);
+        lt.heads[i] = src[i].len ? src[i].buf : NULL;
+    }
+    size_t out_len = 0;
+    if (ok) sort_loserInit(&lt);
+    while (ok && lt.heads[lt.tree[0]] != NULL) {
+        size_t w = lt.tree[0];
+        sort_ext_source* s = &src[w];
+        memcpy(out_buf + out_len, s->buf + s->pos, record_size);
+        out_len += record_size;
+        if (out_len + record_size > out_cap) {
+            ok = sort_extWrite(out, out_buf, out_len);
+            out_len = 0;
+        }
+        s->pos += record_size;
+        if (s->pos == s->len) ok = ok && sort_extRefill(s, record_size);
+        lt.heads[w] = s->pos < s->len ? s->buf + s->pos : NULL;
+        sort_loserReplay(&lt);
+    }
+    if (ok && out_len) ok = sort_extWrite(out, out_buf, out_len);
+    SORT_FREE(lt.tree);
+    SORT_FREE(lt.heads);
+    return ok;
+}
+static bool sort_extAddRun(sort_ext_run** runs, size_t* nruns, size_t* cap, uint64_t offset, uint64_t bytes) {
+    if (*nruns == *cap) {
+        size_t c = *cap ? *cap * 2 : 16;
+        sort_ext_run* r = (sort_ext_run*)SORT_MALLOC(c * sizeof(sort_ext_run));
+        if (!r) { sort_fail(SORT_ERROR_NO_MEMORY); return false; }
+        if (*nruns) memcpy(r, *runs, *nruns * sizeof(sort_ext_run));
+        SORT_FREE(*runs);
+        *runs = r;
+        *cap = c;
+    }
+    (*runs)[*nruns].offset = offset;
+    (*runs)[*nruns].bytes = bytes;
+    (*nruns)++;
+    return true;
+}
+#ifdef SORT_HAS_THREADS
+typedef struct {
+    FILE* f;
+    unsigned char* buf;
+    size_t cap;
+    size_t got;
+} sort_ext_read;
+static void* sort_extReadThread(void* p) {
+    sort_ext_read* r = (sort_ext_read*)p;
+    r->got = fread(r->buf, 1, r->cap, r->f);
+    return NULL;
+}
+#endif
+sort_status_t externalSort(const char* input_path, const char* output_path, const char* temp_dir, size_t record_size, compare_func_t cmp, size_t memory_budget) {
+    assert(input_path != NULL && output_path != NULL && "Paths cannot be NULL");
+    assert(record_size > 0 && "Record size must be positive");
+    assert(cmp != NULL && "Comparison function cannot be NULL");
+    SORT_CALL_BEGIN("externalSort", 0);
+    if (memory_budget < 4 * record_size) memory_budget = 4 * record_size;
+    FILE* in = fopen(input_path, "rb");
+    if (!in) { sort_fail(SORT_ERROR_IO); SORT_CALL_END(); return SORT_ERROR_IO; }
+    setvbuf(in, NULL, _IONBF, 0);
+    FILE* out = NULL;
+    FILE* spill = NULL;
+    sort_ext_run* runs = NULL;
+    size_t nruns = 0, runs_cap = 0;
+    uint64_t spilled = 0;
+    sort_status_t result = SORT_ERROR_IO;
+
+    //Run formation: with threads the budget holds two chunk buffers so the
+    //next chunk can be read while this one is sorted and written
+#ifdef SORT_HAS_THREADS
+    size_t nbufs = 2;
+#else
+    size_t nbufs = 1;
+#endif
+    size_t chunk = memory_budget / nbufs / record_size * record_size;
+    unsigned char* mem = (unsigned char*)SORT_MALLOC(chunk * nbufs);
+    if (!mem) { sort_fail(SORT_ERROR_NO_MEMORY); goto cleanup; }
+    {
+        unsigned char* cur = mem;
+        size_t got = fread(cur, 1, chunk, in);
+        for (;;) {
+            if (ferror(in) || got % record_size != 0) goto cleanup;
+            if (got == 0) break;
+            bool last = got < chunk;
+#ifdef SORT_HAS_THREADS
+            unsigned char* next = cur == mem ? mem + chunk : mem;
+            sort_ext_read reader = {in, next, chunk, 0};
+            pthread_t th;
+            bool reading = !last && pthread_create(&th, NULL, sort_extReadThread, &reader) == 0;
+#endif
+            introSort(cur, got / record_size, record_size, cmp);
+            bool ok;
+            if (last && nruns == 0) {
+                //Everything fit in one chunk: write the result directly
+                out = fopen(output_path, "wb");
+                ok = out != NULL && sort_extWrite(out, cur, got);
+            } else {
+                if (!spill) spill = sort_extTempFile(temp_dir);
+                ok = spill != NULL && sort_extWrite(spill, cur, got) && sort_extAddRun(&runs, &nruns, &runs_cap, spilled, got);
+                spilled += got;
+            }
+#ifdef SORT_HAS_THREADS
+            if (reading) {
+                pthread_join(th, NULL);
+                got = reader.got;
+                cur = next;
+            } else {
+                got = last ? 0 : fread(cur, 1, chunk, in);
+            }
+#else
+            got = last ? 0 : fread(cur, 1, chunk, in);
+#endif
+            if (!ok) goto cleanup;
+            if (last) break;
+        }
+    }
+    SORT_FREE(mem);
+    mem = NULL;
+    if (out == NULL) {
+        out = fopen(output_path, "wb");
+        if (!out) goto cleanup;
+        setvbuf(out, NULL, _IONBF, 0);
+    }
+
+    //Merge passes: each source and the output get an equal share of the
+    //budget; when there are more runs than the budget can buffer, groups of
+    //runs are merged into a new spill file first
+    while (nruns > 0) {
+        size_t min_buf = SORT_EXTERNAL_MIN_BUFFER < record_size ? record_size : SORT_EXTERNAL_MIN_BUFFER;
+        size_t fanin = memory_budget / min_buf;
+        if (fanin > 1) fanin--;
+        if (fanin < 2) fanin = 2;
+        bool final_pass = nruns <= fanin;
+        FILE* dst = final_pass ? out : sort_extTempFile(temp_dir);
+        sort_ext_run* merged = NULL;
+        size_t nmerged = 0, merged_cap = 0;
+        uint64_t written = 0;
+        bool ok = dst != NULL;
+        for (size_t first = 0; ok && first < nruns; first += fanin) {
+            size_t k = nruns - first < fanin ? nruns - first : fanin;
+            size_t share = memory_budget / (k + 1) / record_size * record_size;
+            if (share < record_size) share = record_size;
+            mem = (unsigned char*)SORT_MALLOC(share * (k + 1));
+            sort_ext_source* src = (sort_ext_source*)SORT_CALLOC(k, sizeof(sort_ext_source));
+            ok = mem != NULL && src != NULL;
+            if (!ok) sort_fail(SORT_ERROR_NO_MEMORY);
+            uint64_t bytes = 0;
+            for (size_t i = 0; ok && i < k; i++) {
+                src[i].f = spill;
+                src[i].offset = runs[first + i].offset;
+                src[i].left = runs[first + i].bytes;
+                src[i].buf = mem + i * share;
+                src[i].cap = share;
+                bytes += runs[first + i].bytes;
+            }
+            if (ok && !final_pass) ok = sort_extSeek(dst, written);
+            ok = ok && sort_extMerge(src, k, dst, mem + k * share, share, record_size, cmp);
+            if (ok && !final_pass) ok = sort_extAddRun(&merged, &nmerged, &merged_cap, written, bytes);
+            written += bytes;
+            SORT_FREE(src);
+            SORT_FREE(mem);
+            mem = NULL;
+        }
+        fclose(spill);
+        spill = final_pass ? NULL : dst;
+        SORT_FREE(runs);
+        runs = merged;
+        nruns = nmerged;
+        runs_cap = merged_cap;
+        if (!ok) goto cleanup;
+    }
+    result = SORT_OK;
+
+cleanup:
+    SORT_FREE(mem);
+    SORT_FREE(runs);
+    if (spill) fclose(spill);
+    fclose(in);
+    if (out && fclose(out) != 0) result = SORT_ERROR_IO;
+    //Allocation failures were recorded where they happened; anything else
+    //is an I/O error
+    if (result != SORT_OK) {
+        sort_fail(SORT_ERROR_IO);
+        result = sort_last_status;
+    }
+    SORT_CALL_END();
+    return result;
+}
+
+//22. Indirect Sort
+//For wide records: argSort orders a permutation of indices instead of the
+//records, so the sort itself moves 8- or 16-byte entries, and
+//applyPermutation then moves every record once, following the cycles of the
+//permutation in place. indirectSort does both; pointerSort orders an array of
+//pointers by the records they point to. argSort and indirectSort keep equal
+//records in input order (stable).
+
+//Optional key prefix cached next to each index: prefix(a) < prefix(b) must
+//imply cmp(a, b) < 0 (e.g. the first bytes of a key, big-endian). Only equal
+//prefixes fall back to cmp.
+typedef uint64_t (*sort_prefix_func_t)(const void* elem);
+
+typedef struct {
+    uint64_t prefix;
+    size_t index;
+} sort_arg_entry;
+
+//Records being ordered by the current argSort/pointerSort on this thread; the
+//entry comparators below reach them through it
+typedef struct {
+    const unsigned char* base;
+    size_t size;
+    compare_func_t cmp;
+} sort_arg_state;
+
+static SORT_THREAD_LOCAL sort_arg_state sort_arg_current;
+
+static int sort_argCompareIndex(const void* a, const void* b) {
+    size_t i = *(const size_t*)a, j = *(const size_t*)b;
+    int c = sort_arg_current.cmp(sort_arg_current.base + i * sort_arg_current.size, sort_arg_current.base + j * sort_arg_current.size);
+    if (c != 0) return c;
+    return (i > j) - (i < j);
+}
+
+static int sort_argCompareEntry(const void* a, const void* b) {
+    const sort_arg_entry* x = (const sort_arg_entry*)a;
+    const sort_arg_entry* y = (const sort_arg_entry*)b;
+    if (x->prefix != y->prefix) return x->prefix < y->prefix ? -1 : 1;
+    int c = sort_arg_current.cmp(sort_arg_current.base + x->index * sort_arg_current.size, sort_arg_current.base + y->index * sort_arg_current.size);
+    if (c != 0) return c;
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+static int sort_argComparePointer(const void* a, const void* b) {
+    const void* p = *(const void* const*)a;
+    const void* q = *(const void* const*)b;
+    int c = sort_arg_current.cmp(p, q);
+    if (c != 0) return c;
+    return ((uintptr_t)p > (uintptr_t)q) - ((uintptr_t)p < (uintptr_t)q);
+}
+
+//Fills perm[0, num) so that base[perm[0]], base[perm[1]], ... is sorted; the
+//records are not moved. With prefix != NULL the prefixes are cached next to
+//the indices (16 bytes of temporary space per element; without it, or if
+//that space is unavailable, perm is sorted directly).
+void argSort(const void* base, size_t num, size_t size, compare_func_t cmp, sort_prefix_func_t prefix, size_t* perm) {
+    assert(base != NULL && "Array cannot be NULL");
+    assert(cmp != NULL && "Comparison function cannot be NULL");
+    assert(perm != NULL && "Permutation cannot be NULL");
+    SORT_CALL_BEGIN("argSort", num);
+    for (size_t i = 0; i < num; i++) perm[i] = i;
+    if (num <= 1) { SORT_CALL_END(); return; }
+    //Saved so a comparator may itself call argSort
+    sort_arg_state saved = sort_arg_current;
+    sort_arg_current.base = (const unsigned char*)base;
+    sort_arg_current.size = size;
+    sort_arg_current.cmp = cmp;
+    sort_arg_entry* entries = prefix ? (sort_arg_entry*)SORT_MALLOC(num * sizeof(sort_arg_entry)) : NULL;
+    if (entries) {
+        for (size_t i = 0; i < num; i++) {
+            entries[i].prefix = prefix(sort_arg_current.base + i * size);
+            entries[i].index = i;
+        }
+        introSort(entries, num, sizeof(sort_arg_entry), sort_argCompareEntry);
+        for (size_t i = 0; i < num; i++) perm[i] = entries[i].index;
+        SORT_FREE(entries);
+    } else {
+        introSort(perm, num, sizeof(size_t), sort_argCompareIndex);
+    }
+    sort_arg_current = saved;
+    SORT_CALL_END();
+}
+
+//Rearranges the records so that record i becomes the old base[perm[i]].
+//Each cycle of perm is walked once with a single record held aside, so every
+//record is copied once plus one extra copy per cycle. perm is used as
+//scratch (entries are complemented while visited) and restored on return.
+void applyPermutation(void* base, size_t num, size_t size, size_t* perm) {
+    assert(base != NULL && "Array cannot be NULL");
+    assert(perm != NULL && "Permutation cannot be NULL");
+    SORT_CALL_BEGIN("applyPermutation", num);
+    unsigned char* arr = (unsigned char*)base;
+    unsigned char held[size];
+    for (size_t start = 0; start < num; start++) {
+        size_t next = perm[start];
+        if (next == start || next >= num) continue; //fixed point or already visited
+        memcpy(held, arr + start * size, size);
+        size_t cur = start;
+        while (next != start) {
+            memcpy(arr + cur * size, arr + next * size, size);
+            perm[cur] = ~next;
+            cur = next;
+            next = perm[cur];
+        }
+        memcpy(arr + cur * size, held, size);
+        perm[cur] = ~next;
+        SORT_STATS_MOVES(1);
+    }
+    for (size_t i = 0; i < num; i++) {
+        if (perm[i] >= num) perm[i] = ~perm[i];
+    }
+    SORT_STATS_MOVES(num);
+    SORT_CALL_END();
+}
+
+//Stable sort that moves each record O(1) times: argSort + applyPermutation.
+//Needs num * sizeof(size_t) bytes of temporary space (num * 16 with a
+//prefix); falls back to timSort if it is unavailable.
+void indirectSort(void* base, size_t num, size_t size, compare_func_t cmp, sort_prefix_func_t prefix) {
+    assert(base != NULL && "Array cannot be NULL");
+    assert(cmp != NULL && "Comparison function cannot be NULL");
+    SORT_CALL_BEGIN("indirectSort", num);
+    if (num <= 1) { SORT_CALL_END(); return; }
+    size_t* perm = (size_t*)SORT_MALLOC(num * sizeof(size_t));
+    if (!perm) {
+        timSort(base, num, size, cmp);
+        SORT_CALL_END();
+        return;
+    }
+    argSort(base, num, size, cmp, prefix, perm);
+    applyPermutation(base, num, size, perm);
+    SORT_FREE(perm);
+    SORT_CALL_END();
+}
+
+//Sorts an array of pointers by the records they point to (cmp receives the
+//record pointers, not pointers to the array slots). Equal records keep the
+//order of their addresses.
+void pointerSort(void** ptrs, size_t num, compare_func_t cmp) {
+    assert(ptrs != NULL && "Array cannot be NULL");
+    assert(cmp != NULL && "Comparison function cannot be NULL");
+    SORT_CALL_BEGIN("pointerSort", num);
+    if (num <= 1) { SORT_CALL_END(); return; }
+    sort_arg_state saved = sort_arg_current;
+    sort_arg_current.cmp = cmp;
+    introSort(ptrs, num, sizeof(void*), sort_argComparePointer);
+    sort_arg_current = saved;
+    SORT_CALL_END();
+}
+
+//23. Key Sort
+//Sorts records by normalized binary keys: the caller's extractor writes a
+//fixed-width key for each record once, keys compare with memcmp (unsigned
+//bytes, most significant first), and the records are then ordered by an MSD
+//radix sort over the key bytes followed by applyPermutation. Composite keys
+//are built field by field with the sortKeyPut* encoders, which map integers,
+//floats and strings to bytes that memcmp orders like the values themselves.
+//Equal keys keep their input order (stable).
+typedef void (*sort_key_func_t)(const void* elem, unsigned char* key);
+
+//Big-endian bytes of unsigned integers; each encoder returns the position
+//after the field so fields can be chained
+unsigned char* sortKeyPutU32(unsigned char* out, uint32_t v) {
+    for (int i = 3; i >= 0; i--) { out[i] = (unsigned char)v; v >>= 8; }
+    return out + 4;
+}
+unsigned char* sortKeyPutU64(unsigned char* out, uint64_t v) {
+    for (int i = 7; i >= 0; i--) { out[i] = (unsigned char)v; v >>= 8; }
+    return out + 8;
+}
+unsigned char* sortKeyPutI32(unsigned char* out, int32_t v) {
+    return sortKeyPutU32(out, SORT_RADIX_KEY_SIGNED(uint32_t, (uint32_t)v));
+}
+unsigned char* sortKeyPutI64(unsigned char* out, int64_t v) {
+    return sortKeyPutU64(out, SORT_RADIX_KEY_SIGNED(uint64_t, (uint64_t)v));
+}
+//Floats order by value with -0.0 before +0.0; NaNs sort after +inf (or
+//before -inf when the sign bit is set)
+unsigned char* sortKeyPutF32(unsigned char* out, float v) {
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return sortKeyPutU32(out, SORT_RADIX_KEY_FLOAT(uint32_t, bits));
+}
+unsigned char* sortKeyPutF64(unsigned char* out, double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return sortKeyPutU64(out, SORT_RADIX_KEY_FLOAT(uint64_t, bits));
+}
+//First width bytes of a C string, zero-padded (shorter strings first);
+//strings that agree on the first width bytes compare equal
+unsigned char* sortKeyPutString(unsigned char* out, const char* s, size_t width) {
+    size_t i = 0;
+    for (; i < width && s[i] != '\0'; i++) out[i] = (unsigned char)s[i];
+    memset(out + i, 0, width - i);
+    return out + width;
+}
+unsigned char* sortKeyPutBytes(unsigned char* out, const void* bytes, size_t n) {
+    memcpy(out, bytes, n);
+    return out + n;
+}
+//Reverses the order of a field already written at field[0, n)
+void sortKeyDescending(unsigned char* field, size_t n) {
+    for (size_t i = 0; i < n; i++) field[i] = (unsigned char)~field[i];
+}
+
+//Entries are [key | padding | index]; stride keeps the index aligned
+static size_t sort_keyStride(size_t key_size) {
+    return (key_size + sizeof(size_t) - 1) / sizeof(size_t) * sizeof(size_t) + sizeof(size_t);
+}
+
+static void sort_keyInsertion(unsigned char* e, size_t n, size_t stride, size_t depth, size_t key_size) {
+    unsigned char tmp[stride];
+    for (size_t i = 1; i < n; i++) {
+        size_t j = i;
+        if (memcmp(e + i * stride + depth, e + (i - 1) * stride + depth, key_size - depth) >= 0) continue;
+        memcpy(tmp, e + i * stride, stride);
+        while (j > 0 && memcmp(tmp + depth, e + (j - 1) * stride + depth, key_size - depth) < 0) {
+            memcpy(e + j * stride, e + (j - 1) * stride, stride);
+            j--;
+        }
+        memcpy(e + j * stride, tmp, stride);
+        SORT_STATS_MOVES(i - j + 1);
+    }
+}
+
+//MSD radix over key bytes [depth, key_size): one stable counting pass per
+//byte through scratch, bytes shared by every entry are skipped, and small
+//buckets finish with insertion sort. Buckets other than the largest recurse
+//and the largest continues in the loop, so the stack stays O(log n).
+static void sort_keyMsd(unsigned char* e, unsigned char* scratch, size_t n, size_t stride, size_t depth, size_t key_size) {
+    size_t count[SORT_RADIX_BUCKETS];
+    while (depth < key_size) {
+        if (n < SORT_RADIX_MIN) {
+            sort_keyInsertion(e, n, stride, depth, key_size);
+            return;
+        }
+        memset(count, 0, sizeof(count));
+        for (size_t i = 0; i < n; i++) count[e[i * stride + depth]]++;
+        if (count[e[depth]] == n) {
+            depth++;
+            continue;
+        }
+        size_t sum = 0;
+        for (size_t b = 0; b < SORT_RADIX_BUCKETS; b++) {
+            size_t t = count[b];
+            count[b] = sum;
+            sum += t;
+        }
+        for (size_t i = 0; i < n; i++) {
+            memcpy(scratch + count[e[i * stride + depth]]++ * stride, e + i * stride, stride);
+        }
+        memcpy(e, scratch, n * stride);
+        SORT_STATS_MOVES(2 * n);
+        //count[b] is now the end of bucket b
+        size_t big = 0;
+        for (size_t b = 1; b < SORT_RADIX_BUCKETS; b++) {
+            if (count[b] - count[b - 1] > count[big] - (big ? count[big - 1] : 0)) big = b;
+        }
+        size_t start = 0;
+        for (size_t b = 0; b < SORT_RADIX_BUCKETS; start = count[b++]) {
+            if (b != big && count[b] - start > 1) sort_keyMsd(e + start * stride, scratch, count[b] - start, stride, depth + 1, key_size);
+        }
+        start = big ? count[big - 1] : 0;
+        e += start * stride;
+        n = count[big] - start;
+        depth++;
+    }
+}
+
+//Fills perm[0, num) so that base[perm[0]], base[perm[1]], ... is ordered by
+//the keys extract() writes (key_size bytes each); the records are not moved.
+//Needs 2 * num * (key_size rounded up to 8, plus 8) bytes of temporary space.
+void keyArgSort(const void* base, size_t num, size_t size, size_t key_size, sort_key_func_t extract, size_t* perm) {
+    assert(base != NULL && "Array cannot be NULL");
+    assert(extract != NULL && "Key function cannot be NULL");
+    assert(perm != NULL && "Permutation cannot be NULL");
+    SORT_CALL_BEGIN("keyArgSort", num);
+    for (size_t i = 0; i < num; i++) perm[i] = i;
+    if (num <= 1 || key_size == 0) { SORT_CALL_END(); return; }
+    size_t stride = sort_keyStride(key_size);
+    unsigned char* entries = (unsigned char*)SORT_MALLOC(2 * num * stride);
+    if (!entries) { sort_fail(SORT_ERROR_NO_MEMORY); SORT_CALL_END(); return; }
+    const unsigned char* arr = (const unsigned char*)base;
+    for (size_t i = 0; i < num; i++) {
+        extract(arr + i * size, entries + i * stride);
+        memcpy(entries + i * stride + stride - sizeof(size_t), &i, sizeof(size_t));
+    }
+    sort_keyMsd(entries, entries + num * stride, num, stride, 0, key_size);
+    for (size_t i = 0; i < num; i++) memcpy(perm + i, entries + i * stride + stride - sizeof(size_t), sizeof(size_t));
+    SORT_FREE(entries);
+    SORT_CALL_END();
+}
+
+//Sorts the records by their extracted keys: keyArgSort + applyPermutation
+void keySort(void* base, size_t num, size_t size, size_t key_size, sort_key_func_t extract) {
+    assert(base != NULL && "Array cannot be NULL");
+    assert(extract != NULL && "Key function cannot be NULL");
+    SORT_CALL_BEGIN("keySort", num);
+    if (num <= 1 || key_size == 0) { SORT_CALL_END(); return; }
+    size_t* perm = (size_t*)SORT_MALLOC(num * sizeof(size_t));
+    if (!perm) { sort_fail(SORT_ERROR_NO_MEMORY); SORT_CALL_END(); return; }
+    keyArgSort(base, num, size, key_size, extract, perm);
+    applyPermutation(base, num, size, perm);
+    SORT_FREE(perm);
+    SORT_CALL_END();
+}
+
+//24. String Sort
+//Sorts arrays of NUL-terminated strings into strcmp order without rescanning
+//shared prefixes:
+//  multikeyQuickSort  - three-way radix quicksort (Bentley-Sedgewick):
+//                       partitions on one character, then only the equal
+//                       part moves on to the next character
+//  stringSort         - MSD radix sort: one counting pass per character
+//                       position over buckets of at least
+//                       SORT_STRING_INSERTION strings
+//  parallelStringSort - stringSort whose buckets are sorted as pool tasks
+//The character at the current depth is cached for every string in a byte
+//array, so the partition and counting loops scan sequential memory instead of
+//dereferencing each pointer. Characters shared by a whole bucket are skipped
+//in one pass. lcp (NULL to skip) receives num entries: lcp[0] = 0 and lcp[i]
+//is the length of the common prefix of strs[i - 1] and strs[i], found as a
+//by-product of the sort. Equal strings may be reordered.
+//Both radix sorts need num * (sizeof(char*) + 1) bytes of temporary space,
+//multikeyQuickSort num bytes. Without it they fall back to introSort.
+#ifndef SORT_STRING_INSERTION
+#define SORT_STRING_INSERTION 32
+#endif
+
+static int sort_strCompareRef(const void* a, const void* b) {
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+//lcp[1, n) of strings that agree on their first depth characters
+static void sort_strLcp(const char** s, size_t* lcp, size_t n, size_t depth) {
+    for (size_t i = 1; i < n; i++) {
+        const char* a = s[i - 1] + depth;
+        const char* b = s[i] + depth;
+        size_t k = 0;
+        while (a[k] != '\0' && a[k] == b[k]) k++;
+        lcp[i] = depth + k;
+    }
+}
+
+static void sort_strInsertion(const char** s, size_t* lcp, size_t n, size_t depth) {
+    for (size_t i = 1; i < n; i++) {
+        const char* v = s[i];
+        size_t j = i;
+        while (j > 0 && strcmp(v + depth, s[j - 1] + depth) < 0) {
+            s[j] = s[j - 1];
+            j--;
+        }
+        s[j] = v;
+    }
+    if (lcp) sort_strLcp(s, lcp, n, depth);
+}
+
+static void sort_strFallback(const char** s, size_t* lcp, size_t n) {
+    introSort(s, n, sizeof(char*), sort_strCompareRef);
+    if (lcp) {
+        lcp[0] = 0;
+        sort_strLcp(s, lcp, n, 0);
+    }
+}
+
+static void sort_strFillCache(const char** s, unsigned char* cache, size_t n, size_t depth) {
+    for (size_t i = 0; i < n; i++) cache[i] = (unsigned char)s[i][depth];
+}
+
+//All strings of s[0, n) end at depth: they are equal
+static void sort_strEqual(size_t* lcp, size_t n, size_t depth) {
+    if (lcp) {
+        for (size_t i = 1; i < n; i++) lcp[i] = depth;
+    }
+}
+
+//Length of the prefix s[0, n) share from depth on, given that they share the
+//(non-NUL) character at depth. A shared character often starts a long shared
+//prefix (URLs, paths); measuring it string by string reads each string once
+//instead of once per character.
+static size_t sort_strSharedPrefix(const char** s, size_t n, size_t depth) {
+    const char* first = s[0] + depth;
+    size_t common = strlen(first);
+    for (size_t i = 1; i < n && common > 1; i++) {
+        const char* t = s[i] + depth;
+        size_t k = 1;
+        while (k < common && t[k] == first[k]) k++;
+        common = k;
+    }
+    return common;
+}
+
+static void sort_strMkqsSwap(const char** s, unsigned char* cache, size_t i, size_t j) {
+    const char* t = s[i]; s[i] = s[j]; s[j] = t;
+    unsigned char c = cache[i]; cache[i] = cache[j]; cache[j] = c;
+}
+
+//cache[0, n) holds s[i][depth]. lcp[0] belongs to the caller; the three
+//parts are split by characters at depth, so their boundaries have lcp depth.
+//The largest part is handled by the loop, so the stack stays O(log n).
+static void sort_strMkqs(const char** s, unsigned char* cache, size_t* lcp, size_t n, size_t depth) {
+    while (n >= SORT_STRING_INSERTION) {
+        unsigned char a = cache[0], b = cache[n / 2], c = cache[n - 1];
+        unsigned char pivot = a < b ? (b < c ? b : (a < c ? c : a)) : (a < c ? a : (b < c ? c : b));
+        size_t lt = 0, i = 0, gt = n;
+        while (i < gt) {
+            if (cache[i] < pivot) sort_strMkqsSwap(s, cache, lt++, i++);
+            else if (cache[i] > pivot) sort_strMkqsSwap(s, cache, i, --gt);
+            else i++;
+        }
+        SORT_STATS_SWAPS(n - (gt - lt));
+        if (lcp) {
+            if (lt > 0 && lt < n) lcp[lt] = depth;
+            if (gt > lt && gt < n) lcp[gt] = depth;
+        }
+        //Equal part: continue one character deeper, unless the strings end here
+        size_t eq = gt - lt;
+        if (eq == n && pivot != 0) {
+            depth += sort_strSharedPrefix(s, n, depth);
+            sort_strFillCache(s, cache, n, depth);
+            continue;
+        }
+        if (pivot == 0) {
+            sort_strEqual(lcp ? lcp + lt : NULL, eq, depth);
+            eq = 0;
+        } else if (eq > 1) {
+            sort_strFillCache(s + lt, cache + lt, eq, depth + 1);
+        }
+        size_t less = lt, more = n - gt;
+        if (eq >= less && eq >= more) {
+            if (less > 1) sort_strMkqs(s, cache, lcp, less, depth);
+            if (more > 1) sort_strMkqs(s + gt, cache + gt, lcp ? lcp + gt : NULL, more, depth);
+            if (eq <= 1) return;
+            s += lt; cache += lt; if (lcp) lcp += lt;
+            n = eq; depth++;
+        } else if (less >= more) {
+            if (eq > 1) sort_strMkqs(s + lt, cache + lt, lcp ? lcp + lt : NULL, eq, depth + 1);
+            if (more > 1) sort_strMkqs(s + gt, cache + gt, lcp ? lcp + gt : NULL, more, depth);
+            n = less;
+        } else {
+            if (less > 1) sort_strMkqs(s, cache, lcp, less, depth);
+            if (eq > 1) sort_strMkqs(s + lt, cache + lt, lcp ? lcp + lt : NULL, eq, depth + 1);
+            s += gt; cache += gt; if (lcp) lcp += gt;
+            n = more;
+        }
+    }
+    if (n > 1) sort_strInsertion(s, lcp, n, depth);
+}
+
+//One MSD step on s[0, n) at *depth: skips characters every string shares and
+//distributes by the first differing one through tmp. count[b] is left at the
+//end of bucket b. Returns false when the strings are all equal (nothing left
+//to sort).
+static bool sort_strDistribute(const char** s, const char** tmp, unsigned char* cache, size_t* lcp, size_t n, size_t* depth, size_t* count) {
+    for (;;) {
+        sort_strFillCache(s, cache, n, *depth);
+        memset(count, 0, SORT_RADIX_BUCKETS * sizeof(size_t));
+        for (size_t i = 0; i < n; i++) count[cache[i]]++;
+        if (count[cache[0]] != n) break;
+        if (cache[0] == 0) {
+            sort_strEqual(lcp, n, *depth);
+            return false;
+        }
+        *depth += sort_strSharedPrefix(s, n, *depth);
+    }
+    size_t sum = 0;
+    for (size_t b = 0; b < SORT_RADIX_BUCKETS; b++) {
+        size_t t = count[b];
+        count[b] = sum;
+        sum += t;
+    }
+    for (size_t i = 0; i < n; i++) tmp[count[cache[i]]++] = s[i];
+    memcpy(s, tmp, n * sizeof(char*));
+    SORT_STATS_MOVES(2 * n);
+    if (lcp) {
+        for (size_t b = 0, start = 0; b < SORT_RADIX_BUCKETS; start = count[b++]) {
+            if (start > 0 && count[b] > start) lcp[start] = *depth;
+        }
+    }
+    //Bucket 0 holds strings that end at depth
+    sort_strEqual(lcp, count[0], *depth);
+    return true;
+}
+
+//Buckets other than the largest recurse, so the stack stays O(log n)
+static void sort_strMsd(const char** s, const char** tmp, unsigned char* cache, size_t* lcp, size_t n, size_t depth) {
+    size_t count[SORT_RADIX_BUCKETS];
+    while (n >= SORT_STRING_INSERTION) {
+        if (!sort_strDistribute(s, tmp, cache, lcp, n, &depth, count)) return;
+        size_t big = 1, start = count[0];
+        for (size_t b = 2; b < SORT_RADIX_BUCKETS; b++) {
+            if (count[b] - count[b - 1] > count[big] - count[big - 1]) big = b;
+        }
+        for (size_t b = 1; b < SORT_RADIX_BUCKETS; start = count[b++]) {
+            size_t m = count[b] - start;
+            if (b != big && m > 1) sort_strMsd(s + start, tmp + start, cache + start, lcp ? lcp + start : NULL, m, depth + 1);
+        }
+        start = count[big - 1];
+        n = count[big] - start;
+        s += start; tmp += start; cache += start;
+        if (lcp) lcp += start;
+        depth++;
+    }
+    if (n > 1) sort_strInsertion(s, lcp, n, depth);
+}
+
+void multikeyQuickSort(const char** strs, size_t num, size_t* lcp) {
+    assert(strs != NULL && "Array cannot be NULL");
+    SORT_CALL_BEGIN("multikeyQuickSort", num);
+    if (lcp && num > 0) lcp[0] = 0;
+    if (num <= 1) { SORT_CALL_END(); return; }
+    unsigned char* cache = (unsigned char*)SORT_MALLOC(num);
+    if (!cache) {
+        sort_strFallback(strs, lcp, num);
+        SORT_CALL_END();
+        return;
+    }
+    sort_strFillCache(strs, cache, num, 0);
+    sort_strMkqs(strs, cache, lcp, num, 0);
+    SORT_FREE(cache);
+    SORT_CALL_END();
+}
+
+void stringSort(const char** strs, size_t num, size_t* lcp) {
+    assert(strs != NULL && "Array cannot be NULL");
+    SORT_CALL_BEGIN("stringSort", num);
+    if (lcp && num > 0) lcp[0] = 0;
+    if (num <= 1) { SORT_CALL_END(); return; }
+    const char** tmp = (const char**)SORT_MALLOC(num * (sizeof(char*) + 1));
+    if (!tmp) {
+        sort_strFallback(strs, lcp, num);
+        SORT_CALL_END();
+        return;
+    }
+    sort_strMsd(strs, tmp, (unsigned char*)(tmp + num), lcp, num, 0);
+    SORT_FREE(tmp);
+    SORT_CALL_END();
+}
+
+#ifdef SORT_HAS_THREADS
+typedef struct {
+    const char** s;
+    const char** tmp;
+    unsigned char* cache;
+    size_t* lcp;
+} sort_str_job;
+//arg: lo, num, depth. Buckets work on the matching slices of tmp, cache and
+//lcp, so tasks never share memory.
+static void sort_strParallelTask(sort_pool* pool, size_t worker, const sort_task* task) {
+    sort_str_job* job = (sort_str_job*)task->job;
+    size_t lo = task->arg[0], n = task->arg[1], depth = task->arg[2];
+    size_t* lcp = job->lcp ? job->lcp + lo : NULL;
+    if (n <= SORT_PARALLEL_GRAIN) {
+        sort_strMsd(job->s + lo, job->tmp + lo, job->cache + lo, lcp, n, depth);
+        return;
+    }
+    size_t count[SORT_RADIX_BUCKETS];
+    if (!sort_strDistribute(job->s + lo, job->tmp + lo, job->cache + lo, lcp, n, &depth, count)) return;
+    for (size_t b = 1, start = count[0]; b < SORT_RADIX_BUCKETS; start = count[b++]) {
+        size_t m = count[b] - start;
+        if (m <= 1) continue;
+        sort_task child = *task;
+        child.arg[0] = lo + start;
+        child.arg[1] = m;
+        child.arg[2] = depth + 1;
+        if (m >= SORT_STRING_INSERTION) sortPoolSpawn(pool, worker, &child);
+        else sort_strInsertion(job->s + lo + start, lcp ? lcp + start : NULL, m, depth + 1);
+    }
+}
+#endif
+
+void parallelStringSort(const char** strs, size_t num, size_t* lcp, size_t nthreads) {
+    assert(strs != NULL && "Array cannot be NULL");
+    SORT_CALL_BEGIN("parallelStringSort", num);
+    if (lcp && num > 0) lcp[0] = 0;
+    if (num <= 1) { SORT_CALL_END(); return; }
+#ifdef SORT_HAS_THREADS
+    if (nthreads == 0) nthreads = sortHardwareThreads();
+    const char** tmp = NULL;
+    sort_pool pool;
+    if (nthreads > 1 && num > SORT_PARALLEL_GRAIN && (tmp = (const char**)SORT_MALLOC(num * (sizeof(char*) + 1))) != NULL) {
+        if (sortPoolCreate(&pool, nthreads)) {
+            sort_str_job job = {strs, tmp, (unsigned char*)(tmp + num), lcp};
+            sort_task t;
+            t.fn = sort_strParallelTask;
+            t.job = &job;
+            t.arg[0] = 0; t.arg[1] = num; t.arg[2] = 0;
+            sortPoolSpawn(&pool, 0, &t);
+            sortPoolRun(&pool, 0, true);
+            sortPoolDestroy(&pool);
+        } else {
+            sort_strMsd(strs, tmp, (unsigned char*)(tmp + num), lcp, num, 0);
+        }
+        SORT_FREE(tmp);
+        SORT_CALL_END();
+        return;
+    }
+#else
+    (void)nthreads;
+#endif
+    stringSort(strs, num, lcp);
+    SORT_CALL_END();
+}
+
+//25. Selection
+//  nthElement  - puts the element that belongs at index k there, with no
+//                greater element before it and no smaller one after it
+//                (introselect: the introsort partition loop descending into
+//                one side only; after a few unbalanced partitions it switches
+//                to median-of-medians pivots, so O(n) worst case)
+//  partialSort - the k smallest elements in sorted order at the front,
+//                the rest in unspecified order: O(n + k log k)
+//  sortTopK*   - streaming: keeps the k smallest of the elements pushed so far
+//                in a bounded max-heap, O(log k) per push
+//None of these are stable. For the k largest, pass a reversed comparator.
+#ifndef SORT_SELECT_BAD_LIMIT
+#define SORT_SELECT_BAD_LIMIT 4
+#endif
+static void sort_select(unsigned char* arr, size_t num, size_t k, size_t size, compare_func_t cmp, bool guaranteed);
+//Median of the medians of groups of five, moved to the front of the range
+static size_t sort_medianOfMedians(unsigned char* arr, size_t num, size_t size, compare_func_t cmp) {
+    size_t groups = num / 5;
+    for (size_t g = 0; g < groups; g++) {
+        unsigned char* group = arr + 5 * g * size;
+        insertionSort(group, 5, size, cmp);
+        swap_bytes(arr + g * size, group + 2 * size, size);
+    }
+    sort_select(arr, groups, groups / 2, size, cmp, true);
+    return groups / 2;
+}
+static void sort_select(unsigned char* arr, size_t num, size_t k, size_t size, compare_func_t cmp, bool guaranteed) {
+    size_t bad = 0;
+    while (num > SORT_INSERTION_THRESHOLD) {
+        size_t p;
+        if (guaranteed || bad >= SORT_SELECT_BAD_LIMIT) {
+            guaranteed = true;
+            p = sort_medianOfMedians(arr, num, size, cmp);
+        } else {
+            p = choosePivot(arr, num, size, cmp);
+        }
+        if (p != 0) swap_bytes(arr, arr + p * size, size);
+        size_t lt, gt;
+        partition(arr, num, size, cmp, &lt, &gt);
+        size_t kept;
+        if (k < lt) {
+            kept = lt;
+        } else if (k >= num - gt) {
+            arr += (num - gt) * size;
+            k -= num - gt;
+            kept = gt;
+        } else {
+            return; //k landed among the elements equal to the pivot
+        }
+        //A partition that keeps more than 3/4 of the range is unbalanced
+        if (kept > num - num / 4) bad++;
+        num = kept;
+    }
+    insertionSort(arr, num, size, cmp);
+}
+
+void nthElement(void* base, size_t num, size_t size, compare_func_t cmp, size_t k) {
+    assert(base != NULL && "Array cannot be NULL");
+    assert(cmp != NULL && "Comparison function cannot be NULL");
+    assert(k < num && "Index out of range");
+    SORT_CALL_BEGIN("nthElement", num);
+    if (num <= 1) { SORT_CALL_END(); return; }
+    sort_select((unsigned char*)base, num, k, size, cmp, false);
+    SORT_CALL_END();
+}
+
+void partialSort(void* base, size_t num, size_t size, compare_func_t cmp, size_t k) {
+    assert(base != NULL && "Array cannot be NULL");
+    assert(cmp != NULL && "Comparison function cannot be NULL");
+    SORT_CALL_BEGIN("partialSort", num);
+    if (k > num) k = num;
+    if (k < num) {
+        if (k == 0) { SORT_CALL_END(); return; }
+        sort_select((unsigned char*)base, num, k - 1, size, cmp, false);
+    }
+    introSort(base, k, size, cmp);
+    SORT_CALL_END();
+}
+
+typedef struct {
+    unsigned char* heap; // the k smallest so far; a max-heap once full
+    size_t k;
+    size_t count;
+    size_t size;
+    compare_func_t cmp;
+    bool owned;
+} sort_topk_t;
+
+//Prepares tk to keep the k smallest elements pushed. buffer (k * size
+//bytes) may be NULL to allocate it from the active sort context; returns
+//false if that fails.
+bool sortTopKInit(sort_topk_t* tk, size_t k, size_t size, compare_func_t cmp, void* buffer) {
+    assert(tk != NULL && "Top-k state cannot be NULL");
+    assert(cmp != NULL && "Comparison function cannot be NULL");
+    tk->k = k;
+    tk->count = 0;
+    tk->size = size;
+    tk->cmp = cmp;
+    tk->owned = buffer == NULL && k > 0;
+    tk->heap = (unsigned char*)(tk->owned ? SORT_MALLOC(k * size) : buffer);
+    if (tk->owned && !tk->heap) {
+        sort_fail(SORT_ERROR_NO_MEMORY);
+        tk->k = 0;
+        tk->owned = false;
+        return false;
+    }
+    return true;
+}
+
+void sortTopKPush(sort_topk_t* tk, const void* elem) {
+    if (tk->count < tk->k) {
+        memcpy(tk->heap + tk->count * tk->size, elem, tk->size);
+        //Heapify once full, like heapSort's build phase
+        if (++tk->count == tk->k) {
+            for (size_t i = tk->k / 2; i-- > 0;) heapify(tk->heap, tk->k, i, tk->size, tk->cmp);
+        }
+    } else if (tk->k > 0 && SORT_CMP(tk->cmp, elem, tk->heap) < 0) {
+        memcpy(tk->heap, elem, tk->size);
+        heapify(tk->heap, tk->k, 0, tk->size, tk->cmp);
+    }
+}
+
+void sortTopKPushMany(sort_topk_t* tk, const void* base, size_t num) {
+    const unsigned char* arr = (const unsigned char*)base;
+    for (size_t i = 0; i < num; i++) sortTopKPush(tk, arr + i * tk->size);
+}
+
+//Copies the elements kept so far to out in sorted order and returns how many
+//there are (min(k, pushed)); tk can keep receiving elements afterwards
+size_t sortTopKResult(const sort_topk_t* tk, void* out) {
+    assert(out != NULL || tk->count == 0);
+    if (tk->count == 0) return 0;
+    memcpy(out, tk->heap, tk->count * tk->size);
+    introSort(out, tk->count, tk->size, tk->cmp);
+    return tk->count;
+}
+
+void sortTopKFree(sort_topk_t* tk) {
+    if (tk->owned) SORT_FREE(tk->heap);
+    tk->heap = NULL;
+    tk->owned = false;
+    tk->k = 0;
+    tk->count = 0;
+}
+
+//26. Incremental Merge
+//For sorted arrays that grow in batches: the new elements are sorted on their
+//own and merged into the sorted part instead of re-sorting everything.
+//  mergeSortedBatch - sorts base[sorted_num, +batch_num) and merges it into
+//                     the sorted base[0, sorted_num) with timSort's galloping
+//                     merge: O(b log b + n), and O(b + log n) when the batch
+//                     lands at the end
+//  sort_runs_t      - defers the merge: appended batches become sorted runs
+//                     that coalesce timsort-style (pending run lengths grow
+//                     like Fibonacci numbers towards the oldest), and
+//                     sortRunsFlush merges them into the sorted part once
+//Merges need a buffer of the shorter run (after galloping trims both ends).
+//Without one they merge in place by rotations, O(n log n), no memory. All of
+//this is stable: existing elements stay before equal new ones.
+static void sort_rotate(unsigned char* arr, size_t n1, size_t n2, size_t size) {
+    reverseRange(arr, n1, size);
+    reverseRange(arr + n1 * size, n2, size);
+    reverseRange(arr, n1 + n2, size);
+}
+//Stable merge of arr[0, n1) and arr[n1, +n2) without a buffer: split the
+//longer run in half, binary-search the matching cut in the other, rotate the
+//middle pieces together and merge both sides (the larger one in the loop)
+static void sort_mergeInPlace(unsigned char* arr, size_t n1, size_t n2, size_t size, compare_func_t cmp) {
+    while (n1 > 0 && n2 > 0) {
+        if (n1 + n2 == 2) {
+            if (SORT_CMP(cmp, arr + size, arr) < 0) swap_bytes(arr, arr + size, size);
+            return;
+        }
+        size_t cut1, cut2;
+        if (n1 >= n2) {
+            cut1 = n1 / 2;
+            cut2 = gallopLeft(arr + cut1 * size, arr + n1 * size, n2, 0, size, cmp);
+        } else {
+            cut2 = n2 / 2;
+            cut1 = gallopRight(arr + (n1 + cut2) * size, arr, n1, 0, size, cmp);
+        }
+        sort_rotate(arr + cut1 * size, n1 - cut1, cut2, size);
+        size_t mid = cut1 + cut2;
+        if (cut1 + cut2 < n1 + n2 - mid) {
+            sort_mergeInPlace(arr, cut1, cut2, size, cmp);
+            arr += mid * size;
+            n1 -= cut1;
+            n2 -= cut2;
+        } else {
+            sort_mergeInPlace(arr + mid * size, n1 - cut1, n2 - cut2, size, cmp);
+            n1 = cut1;
+            n2 = cut2;
+        }
+    }
+}
+//Merges the sorted runs arr[0, n1) and arr[n1, +n2). Uses buffer when it
+//holds the shorter (trimmed) run, else allocates it when may_alloc, else
+//merges in place.
+static void sort_mergeAdjacent(unsigned char* arr, size_t n1, size_t n2, size_t size, compare_func_t cmp, void* buffer, size_t buffer_size, bool may_alloc) {
+    if (n1 == 0 || n2 == 0) return;
+    size_t k = gallopRight(arr + n1 * size, arr, n1, 0, size, cmp);
+    arr += k * size;
+    n1 -= k;
+    if (n1 == 0) return;
+    n2 = gallopLeft(arr + (n1 - 1) * size, arr + n1 * size, n2, n2 - 1, size, cmp);
+    if (n2 == 0) return;
+    size_t need = (n1 <= n2 ? n1 : n2) * size;
+    void* owned = NULL;
+    if (buffer == NULL || buffer_size < need) {
+        buffer = owned = may_alloc ? SORT_MALLOC(need) : NULL;
+    }
+    if (buffer == NULL) {
+        sort_mergeInPlace(arr, n1, n2, size, cmp);
+        return;
+    }
+    timsort_state ts;
+    ts.arr = arr;
+    ts.tmp = (unsigned char*)buffer;
+    ts.size = size;
+    ts.cmp = cmp;
+    ts.min_gallop = SORT_MIN_GALLOP;
+    ts.stack_size = 0;
+    SORT_STATS_MOVES(n1 + n2 + need / size);
+    if (n1 <= n2) timMergeLo(&ts, 0, n1, n1, n2);
+    else timMergeHi(&ts, 0, n1, n1, n2);
+    SORT_FREE(owned);
+}
+//Stable sort with no buffer: binary insertion on SORT_MIN_MERGE / 2 blocks,
+//then in-place merges, O(n log^2 n)
+static void sort_mergeSortInPlace(unsigned char* arr, size_t num, size_t size, compare_func_t cmp) {
+    size_t block = SORT_MIN_MERGE / 2;
+    for (size_t lo = 0; lo < num; lo += block) {
+        size_t n = num - lo < block ? num - lo : block;
+        timBinaryInsertion(arr + lo * size, n, 0, size, cmp);
+    }
+    for (size_t width = block; width < num; width *= 2) {
+        for (size_t lo = 0; lo + width < num; lo += 2 * width) {
+            size_t n2 = num - lo - width < width ? num - lo - width : width;
+            sort_mergeAdjacent(arr + lo * size, width, n2, size, cmp, NULL, 0, false);
+        }
+    }
+}
+
+//Bytes of buffer that let mergeSortedBatchWithBuffer sort and merge without
+//falling back to in-place merging
+size_t mergeSortedBatchBufferSize(size_t sorted_num, size_t batch_num, size_t size) {
+    size_t merge = sorted_num < batch_num ? sorted_num : batch_num;
+    size_t sort = timSortBufferSize(batch_num, size) / (size ? size : 1);
+    return (merge > sort ? merge : sort) * size;
+}
+
+//Never allocates: with a buffer smaller than mergeSortedBatchBufferSize the
+//batch is sorted and merged in place instead (slower, same result)
+void mergeSortedBatchWithBuffer(void* base, size_t sorted_num, size_t batch_num, size_t size, compare_func_t cmp, void* buffer, size_t buffer_size) {
+    assert(base != NULL && "Array cannot be NULL");
+    assert(cmp != NULL && "Comparison function cannot be NULL");
+    SORT_CALL_BEGIN("mergeSortedBatchWithBuffer", sorted_num + batch_num);
+    unsigned char* arr = (unsigned char*)base;
+    unsigned char* batch = arr + sorted_num * size;
+    if (buffer != NULL && buffer_size >= timSortBufferSize(batch_num, size)) {
+        timSortWithBuffer(batch, batch_num, size, cmp, buffer, buffer_size);
+    } else {
+        sort_mergeSortInPlace(batch, batch_num, size, cmp);
+    }
+    sort_mergeAdjacent(arr, sorted_num, batch_num, size, cmp, buffer, buffer_size, false);
+    SORT_CALL_END();
+}
+
+void mergeSortedBatch(void* base, size_t sorted_num, size_t batch_num, size_t size, compare_func_t cmp) {
+    assert(base != NULL && "Array cannot be NULL");
+    assert(cmp != NULL && "Comparison function cannot be NULL");
+    SORT_CALL_BEGIN("mergeSortedBatch", sorted_num + batch_num);
+    size_t bytes = mergeSortedBatchBufferSize(sorted_num, batch_num, size);
+    void* buffer = bytes > 0 ? SORT_MALLOC(bytes) : NULL;
+    mergeSortedBatchWithBuffer(base, sorted_num, batch_num, size, cmp, buffer, buffer ? bytes : 0);
+    SORT_FREE(buffer);
+    SORT_CALL_END();
+}
+
+typedef struct {
+    unsigned char* base; // the array; update it if the array is reallocated
+    size_t size;
+    compare_func_t cmp;
+    size_t num; // elements covered by runs: base[0, num)
+    size_t run_count;
+    size_t run_len[SORT_MAX_RUNS]; // run 0 is the sorted part, then pending batches
+} sort_runs_t;
+
+//Tracks base[0, sorted_num) as sorted
+void sortRunsInit(sort_runs_t* runs, void* base, size_t sorted_num, size_t size, compare_func_t cmp) {
+    assert(runs != NULL && "Run tracker cannot be NULL");
+    assert(cmp != NULL && "Comparison function cannot be NULL");
+    runs->base = (unsigned char*)base;
+    runs->size = size;
+    runs->cmp = cmp;
+    runs->num = sorted_num;
+    runs->run_count = 1;
+    runs->run_len[0] = sorted_num;
+}
+
+//Merges run i with run i + 1
+static void sort_runsMergeAt(sort_runs_t* runs, size_t i) {
+    size_t n1 = runs->run_len[i], n2 = runs->run_len[i + 1], after = 0;
+    for (size_t j = i + 2; j < runs->run_count; j++) after += runs->run_len[j];
+    unsigned char* start = runs->base + (runs->num - after - n1 - n2) * runs->size;
+    sort_mergeAdjacent(start, n1, n2, runs->size, runs->cmp, NULL, 0, true);
+    runs->run_len[i] = n1 + n2;
+    for (size_t j = i + 1; j + 1 < runs->run_count; j++) runs->run_len[j] = runs->run_len[j + 1];
+    runs->run_count--;
+}
+
+//Sorts the batch_num elements the caller wrote at base[num, +batch_num) and
+//queues them as a pending run. Pending runs keep timSort's invariant: each is
+//longer than the next and longer than the two after it combined, so lengths
+//grow at least like Fibonacci numbers from the newest to the oldest, at most
+//O(log n) runs are pending and each element is merged O(log n) times before
+//the flush. A full run stack forces a merge.
+void sortRunsAppend(sort_runs_t* runs, size_t batch_num) {
+    assert(runs != NULL && runs->base != NULL && "Run tracker is not initialized");
+    SORT_CALL_BEGIN("sortRunsAppend", batch_num);
+    if (batch_num == 0) { SORT_CALL_END(); return; }
+    timSort(runs->base + runs->num * runs->size, batch_num, runs->size, runs->cmp);
+    if (runs->run_count == SORT_MAX_RUNS) sort_runsMergeAt(runs, runs->run_count - 2);
+    runs->run_len[runs->run_count++] = batch_num;
+    runs->num += batch_num;
+    size_t* len = runs->run_len;
+    //Same collapse as timSort's, over the pending runs 1..run_count-1
+    while (runs->run_count > 2) {
+        size_t n = runs->run_count - 2;
+        if ((n >= 2 && len[n - 1] <= len[n] + len[n + 1]) || (n >= 3 && len[n - 2] <= len[n - 1] + len[n])) {
+            if (len[n - 1] < len[n + 1]) n--;
+        } else if (len[n] > len[n + 1]) {
+            break;
+        }
+        sort_runsMergeAt(runs, n);
+    }
+    SORT_CALL_END();
+}
+
+//Merges the pending runs into the sorted part: afterwards base[0, num) is
+//sorted
+void sortRunsFlush(sort_runs_t* runs) {
+    assert(runs != NULL && runs->base != NULL && "Run tracker is not initialized");
+    SORT_CALL_BEGIN("sortRunsFlush", runs->num);
+    while (runs->run_count > 1) sort_runsMergeAt(runs, runs->run_count - 2);
+    SORT_CALL_END();
+}
+
+//27. Block Merge Sort
+//Stable O(n log n) sort in O(sqrt n) extra memory. Binary insertion sorts
+//runs of SORT_MIN_MERGE / 2, then runs merge bottom-up; pairs already in
+//order are skipped. A merge whose shorter run fits the buffer is timSort's
+//galloping merge. A longer one is a block merge of A and B:
+//  - cut both into blocks of bs = ceil(sqrt(n1 + n2)) elements, leaving the
+//    partial head of A in place and the partial tail of B aside
+//  - order the blocks by their first elements (A's first on ties) and move
+//    them there by cycle-following
+//  - merge left to right: the pending fragment (at most bs elements, copied
+//    to the buffer) merges with the next block from the other run, and
+//    whatever is left over, of either origin, becomes the new fragment
+//  - merge the tail of B in with the galloping merge
+//The buffer needs bs elements and bs indices. Without it the merges rotate in
+//place: still stable, O(n log^2 n), no memory at all.
+#ifndef SORT_BLOCK_MERGE_RUN
+#define SORT_BLOCK_MERGE_RUN (SORT_MIN_MERGE / 2) // insertion-sorted run length
+#endif
+
+//ceil(sqrt(n)), by Newton's method on integers
+static size_t sort_blockSize(size_t n) {
+    if (n < 2) return 1;
+    size_t x = n, y = (n + 1) / 2;
+    while (y < x) {
+        x = y;
+        y = (x + n / x) / 2;
+    }
+    return x * x < n ? x + 1 : x;
+}
+
+//Carves bs block indices and a bs-element block out of buffer (indices first,
+//aligned); false when it is too small
+static bool sort_blockLayout(void* buffer, size_t buffer_size, size_t bs, size_t size, size_t** order, unsigned char** tmp) {
+    if (buffer == NULL) return false;
+    size_t pad = (sizeof(size_t) - (uintptr_t)buffer % sizeof(size_t)) % sizeof(size_t);
+    if (bs > (SIZE_MAX - pad) / (sizeof(size_t) + size)) return false;
+    if (pad + bs * (sizeof(size_t) + size) > buffer_size) return false;
+    *order = (size_t*)((unsigned char*)buffer + pad);
+    *tmp = (unsigned char*)(*order + bs);
+    return true;
+}
+
+//Stable merge of arr[0, n1) and arr[n1, +n2) through blocks, see above.
+//Needs min(n1, n2) >= bs and a buffer that passes sort_blockLayout.
+static void sort_blockMergeBlocks(unsigned char* arr, size_t n1, size_t n2, size_t bs, size_t size, compare_func_t cmp, size_t* order, unsigned char* tmp) {
+    size_t head = n1 % bs, na = n1 / bs, nb = n2 / bs, m = na + nb;
+    unsigned char* blocks = arr + head * size;
+    //Block c starts at blocks + c * bs; A's are 0..na-1, B's na..m-1
+    size_t ia = 0, ib = na, p = 0;
+    while (ia < na && ib < m) {
+        if (SORT_CMP(cmp, blocks + ib * bs * size, blocks + ia * bs * size) < 0) order[p++] = ib++;
+        else order[p++] = ia++;
+    }
+    while (ia < na) order[p++] = ia++;
+    while (ib < m) order[p++] = ib++;
+    //order[p] is the block that belongs at p; visited entries are complemented
+    for (p = 0; p < m; p++) {
+        if (order[p] == p || order[p] > m) continue;
+        memcpy(tmp, blocks + p * bs * size, bs * size);
+        size_t j = p;
+        while (order[j] != p) {
+            size_t src = order[j];
+            memcpy(blocks + j * bs * size, blocks + src * bs * size, bs * size);
+            order[j] = ~src;
+            j = src;
+        }
+        memcpy(blocks + j * bs * size, tmp, bs * size);
+        order[j] = ~p;
+    }
+    SORT_STATS_MOVES(m * bs);
+    unsigned char* pend = arr;
+    size_t plen = head;
+    bool pend_a = true;
+    for (p = 0; p < m; p++) {
+        size_t c = order[p] > m ? ~order[p] : order[p];
+        bool blk_a = c < na;
+        unsigned char* blk = blocks + p * bs * size;
+        //The fragment is final when empty, of the same run or already in order
+        if (plen == 0 || blk_a == pend_a ||
+            (pend_a ? SORT_CMP(cmp, blk, blk - size) >= 0 : SORT_CMP(cmp, blk - size, blk) < 0)) {
+            pend = blk;
+            plen = bs;
+            pend_a = blk_a;
+            continue;
+        }
+        SORT_STATS_MOVES(2 * plen + bs);
+        memcpy(tmp, pend, plen * size);
+        size_t i = 0, j = 0;
+        unsigned char* out = pend;
+        while (i < plen && j < bs) {
+            //Ties go to A, whichever side it is on
+            bool take_blk = pend_a ? SORT_CMP(cmp, blk + j * size, tmp + i * size) < 0
+                                   : SORT_CMP(cmp, tmp + i * size, blk + j * size) >= 0;
+            if (take_blk) { memcpy(out, blk + j * size, size); j++; }
+            else { memcpy(out, tmp + i * size, size); i++; }
+            out += size;
+        }
+        if (i == plen) {
+            pend = blk + j * size;
+            plen = bs - j;
+            pend_a = blk_a;
+        } else {
+            memcpy(out, tmp + i * size, (plen - i) * size);
+            pend = out;
+            plen -= i;
+        }
+    }
+}
+
+//Merges the sorted runs arr[0, n1) and arr[n1, +n2) with the buffer
+static void sort_blockMerge(unsigned char* arr, size_t n1, size_t n2, size_t size, compare_func_t cmp, void* buffer, size_t buffer_size) {
+    if (n1 == 0 || n2 == 0) return;
+    size_t k = gallopRight(arr + n1 * size, arr, n1, 0, size, cmp);
+    arr += k * size;
+    n1 -= k;
+    if (n1 == 0) return;
+    n2 = gallopLeft(arr + (n1 - 1) * size, arr + n1 * size, n2, n2 - 1, size, cmp);
+    if (n2 == 0) return;
+    size_t shorter = n1 <= n2 ? n1 : n2;
+    if (buffer != NULL && shorter * size <= buffer_size) {
+        sort_mergeAdjacent(arr, n1, n2, size, cmp, buffer, buffer_size, false);
+        return;
+    }
+    size_t bs = sort_blockSize(n1 + n2);
+    size_t* order;
+    unsigned char* tmp;
+    if (shorter < bs || !sort_blockLayout(buffer, buffer_size, bs, size, &order, &tmp)) {
+        sort_mergeInPlace(arr, n1, n2, size, cmp);
+        return;
+    }
+    size_t tail = n2 % bs;
+    sort_blockMergeBlocks(arr, n1, n2 - tail, bs, size, cmp, order, tmp);
+    //The tail is shorter than a block, so the buffer holds it
+    sort_mergeAdjacent(arr, n1 + n2 - tail, tail, size, cmp, tmp, bs * size, false);
+}
+
+//Bytes of buffer that let blockMergeSortWithBuffer block-merge every pass
+size_t blockMergeSortBufferSize(size_t num, size_t size) {
+    if (num < 2 * SORT_BLOCK_MERGE_RUN) return 0;
+    return sort_blockSize(num) * (sizeof(size_t) + size) + sizeof(size_t);
+}
+
+//Never allocates: with a buffer smaller than blockMergeSortBufferSize the
+//long merges rotate in place instead (slower, same result)
+void blockMergeSortWithBuffer(void* base, size_t num, size_t size, compare_func_t cmp, void* buffer, size_t buffer_size) {
+    assert(base != NULL && "Array cannot be NULL");
+    assert(cmp != NULL && "Comparison function cannot be NULL");
+    SORT_CALL_BEGIN("blockMergeSortWithBuffer", num);
+    unsigned char* arr = (unsigned char*)base;
+    size_t run = SORT_BLOCK_MERGE_RUN;
+    for (size_t lo = 0; lo < num; lo += run) {
+        size_t n = num - lo < run ? num - lo : run;
+        timBinaryInsertion(arr + lo * size, n, 0, size, cmp);
+    }
+    for (size_t width = run; width < num; width *= 2) {
+        for (size_t lo = 0; lo + width < num; lo += 2 * width) {
+            unsigned char* a = arr + lo * size;
+            size_t n2 = num - lo - width < width ? num - lo - width : width;
+            if (SORT_CMP(cmp, a + (width - 1) * size, a + width * size) <= 0) continue;
+            sort_blockMerge(a, width, n2, size, cmp, buffer, buffer_size);
+        }
+    }
+    SORT_CALL_END();
+}
+
+//Allocates the O(sqrt n) buffer from the sort context; if that fails it sorts
+//in place without reporting an error
+void blockMergeSort(void* base, size_t num, size_t size, compare_func_t cmp) {
+    assert(base != NULL && "Array cannot be NULL");
+    assert(cmp != NULL && "Comparison function cannot be NULL");
+    SORT_CALL_BEGIN("blockMergeSort", num);
+    size_t bytes = blockMergeSortBufferSize(num, size);
+    void* buffer = bytes > 0 ? SORT_MALLOC(bytes) : NULL;
+    blockMergeSortWithBuffer(base, num, size, cmp, buffer, buffer ? bytes : 0);
+    SORT_FREE(buffer);
+    SORT_CALL_END();
+}
+
+//28. Segmented Sorts
+//Sorts many small independent arrays that share one buffer in a single call:
+//per-row feature lists, per-bucket posting lists. Segment i is
+//  sortSegments*        - base[offsets[i], offsets[i + 1]), count + 1 offsets
+//  sortSegmentsStrided* - base[i * stride, +len), len <= stride
+//The per-call checks and setup are paid once per batch. Typed variants sort
+//up to SORT_SEGMENT_NET elements with a branch-free sorting network, running
+//two equal-length segments through it together so their compare-exchanges
+//overlap; up to SORT_SEGMENT_MAX elements they sort blocks of
+//SORT_SEGMENT_NET with the network and merge them branch-free; longer
+//segments go to quickSort##Name. The generic variants use insertion sort up
+//to SORT_SEGMENT_MAX and introSort beyond. With nthreads != 1 and at least
+//2 * SORT_PARALLEL_GRAIN elements in total, the segments are cut into ranges
+//of about equal element counts, one task each. None of these is stable.
+#ifndef SORT_SEGMENT_MAX
+#define SORT_SEGMENT_MAX 64 // longest segment sorted without a full sort call
+#endif
+#define SORT_SEGMENT_NET 16
+
+//Batcher odd-even merge networks for 2..SORT_SEGMENT_NET elements, as index
+//pairs; the network for n is pairs [sort_segment_net_start[n],
+//sort_segment_net_start[n + 1]), in layer order
+static const unsigned char sort_segment_net[][2] = {
+    /* 2 */ {0, 1},
+    /* 3 */ {0, 1}, {0, 2}, {1, 2},
+    /* 4 */ {0, 1}, {2, 3}, {0, 2}, {1, 3}, {1, 2},
+    /* 5 */ {0, 1}, {2, 3}, {0, 2}, {1, 3}, {1, 2}, {0, 4}, {2, 4}, {1, 2}, {3, 4},
+    /* 6 */ {0, 1}, {2, 3}, {4, 5}, {0, 2}, {1, 3}, {1, 2}, {0, 4}, {1, 5}, {2, 4}, {3, 5},
+        {1, 2}, {3, 4},
+    /* 7 */ {0, 1}, {2, 3}, {4, 5}, {0, 2}, {1, 3}, {4, 6}, {1, 2}, {5, 6}, {0, 4}, {1, 5},
+        {2, 6}, {2, 4}, {3, 5}, {1, 2}, {3, 4}, {5, 6},
+    /* 8 */ {0, 1}, {2, 3}, {4, 5}, {6, 7}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {1, 2}, {5, 6},
+        {0, 4}, {1, 5}, {2, 6}, {3, 7}, {2, 4}, {3, 5}, {1, 2}, {3, 4}, {5, 6},
+    /* 9 */ {0, 1}, {2, 3}, {4, 5}, {6, 7}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {1, 2}, {5, 6},
+        {0, 4}, {1, 5}, {2, 6}, {3, 7}, {2, 4}, {3, 5}, {1, 2}, {3, 4}, {5, 6}, {0, 8}, {4, 8},
+        {2, 4}, {3, 5}, {6, 8}, {1, 2}, {3, 4}, {5, 6}, {7, 8},
+    /* 10 */ {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {1, 2},
+        {5, 6}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {2, 4}, {3, 5}, {1, 2}, {3, 4}, {5, 6}, {0, 8},
+        {1, 9}, {4, 8}, {5, 9}, {2, 4}, {3, 5}, {6, 8}, {7, 9}, {1, 2}, {3, 4}, {5, 6}, {7, 8},
+    /* 11 */ {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {8, 10},
+        {1, 2}, {5, 6}, {9, 10}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {2, 4}, {3, 5}, {1, 2}, {3, 4},
+        {5, 6}, {9, 10}, {0, 8}, {1, 9}, {2, 10}, {4, 8}, {5, 9}, {6, 10}, {2, 4}, {3, 5}, {6, 8},
+        {7, 9}, {1, 2}, {3, 4}, {5, 6}, {7, 8}, {9, 10},
+    /* 12 */ {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11}, {0, 2}, {1, 3}, {4, 6}, {5, 7},
+        {8, 10}, {9, 11}, {1, 2}, {5, 6}, {9, 10}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {2, 4}, {3, 5},
+        {1, 2}, {3, 4}, {5, 6}, {9, 10}, {0, 8}, {1, 9}, {2, 10}, {3, 11}, {4, 8}, {5, 9},
+        {6, 10}, {7, 11}, {2, 4}, {3, 5}, {6, 8}, {7, 9}, {1, 2}, {3, 4}, {5, 6}, {7, 8}, {9, 10},
+    /* 13 */ {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11}, {0, 2}, {1, 3}, {4, 6}, {5, 7},
+        {8, 10}, {9, 11}, {1, 2}, {5, 6}, {9, 10}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {8, 12},
+        {2, 4}, {3, 5}, {10, 12}, {1, 2}, {3, 4}, {5, 6}, {9, 10}, {11, 12}, {0, 8}, {1, 9},
+        {2, 10}, {3, 11}, {4, 12}, {4, 8}, {5, 9}, {6, 10}, {7, 11}, {2, 4}, {3, 5}, {6, 8},
+        {7, 9}, {10, 12}, {1, 2}, {3, 4}, {5, 6}, {7, 8}, {9, 10}, {11, 12},
+    /* 14 */ {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11}, {12, 13}, {0, 2}, {1, 3}, {4, 6},
+        {5, 7}, {8, 10}, {9, 11}, {1, 2}, {5, 6}, {9, 10}, {0, 4}, {1, 5}, {2, 6}, {3, 7},
+        {8, 12}, {9, 13}, {2, 4}, {3, 5}, {10, 12}, {11, 13}, {1, 2}, {3, 4}, {5, 6}, {9, 10},
+        {11, 12}, {0, 8}, {1, 9}, {2, 10}, {3, 11}, {4, 12}, {5, 13}, {4, 8}, {5, 9}, {6, 10},
+        {7, 11}, {2, 4}, {3, 5}, {6, 8}, {7, 9}, {10, 12}, {11, 13}, {1, 2}, {3, 4}, {5, 6},
+        {7, 8}, {9, 10}, {11, 12},
+    /* 15 */ {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11}, {12, 13}, {0, 2}, {1, 3}, {4, 6},
+        {5, 7}, {8, 10}, {9, 11}, {12, 14}, {1, 2}, {5, 6}, {9, 10}, {13, 14}, {0, 4}, {1, 5},
+        {2, 6}, {3, 7}, {8, 12}, {9, 13}, {10, 14}, {2, 4}, {3, 5}, {10, 12}, {11, 13}, {1, 2},
+        {3, 4}, {5, 6}, {9, 10}, {11, 12}, {13, 14}, {0, 8}, {1, 9}, {2, 10}, {3, 11}, {4, 12},
+        {5, 13}, {6, 14}, {4, 8}, {5, 9}, {6, 10}, {7, 11}, {2, 4}, {3, 5}, {6, 8}, {7, 9},
+        {10, 12}, {11, 13}, {1, 2}, {3, 4}, {5, 6}, {7, 8}, {9, 10}, {11, 12}, {13, 14},
+    /* 16 */ {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11}, {12, 13}, {14, 15}, {0, 2}, {1, 3},
+        {4, 6}, {5, 7}, {8, 10}, {9, 11}, {12, 14}, {13, 15}, {1, 2}, {5, 6}, {9, 10}, {13, 14},
+        {0, 4}, {1, 5}, {2, 6}, {3, 7}, {8, 12}, {9, 13}, {10, 14}, {11, 15}, {2, 4}, {3, 5},
+        {10, 12}, {11, 13}, {1, 2}, {3, 4}, {5, 6}, {9, 10}, {11, 12}, {13, 14}, {0, 8}, {1, 9},
+        {2, 10}, {3, 11}, {4, 12}, {5, 13}, {6, 14}, {7, 15}, {4, 8}, {5, 9}, {6, 10}, {7, 11},
+        {2, 4}, {3, 5}, {6, 8}, {7, 9}, {10, 12}, {11, 13}, {1, 2}, {3, 4}, {5, 6}, {7, 8},
+        {9, 10}, {11, 12}, {13, 14},
+};
+static const unsigned short sort_segment_net_start[SORT_SEGMENT_NET + 2] = {
+    0, 0, 0, 1, 4, 9, 18, 30, 46, 65, 93, 125, 163, 205, 253, 306, 365, 428
+};
+
+typedef struct sort_segment_job_s {
+    unsigned char* base;
+    const size_t* offsets; // NULL for strided segments
+    size_t len, stride, size;
+    compare_func_t cmp;
+    void (*run)(const struct sort_segment_job_s* job, size_t first, size_t last);
+} sort_segment_job;
+
+static size_t sort_segmentStart(const sort_segment_job* job, size_t i) {
+    return job->offsets ? job->offsets[i] : i * job->stride;
+}
+static size_t sort_segmentLen(const sort_segment_job* job, size_t i) {
+    return job->offsets ? job->offsets[i + 1] - job->offsets[i] : job->len;
+}
+
+//Straight insertion with the caller's key buffer; on short segments it beats
+//binary insertion, whose memmove and search overhead dominate there
+static void sort_segmentInsertion(unsigned char* arr, size_t n, size_t size, compare_func_t cmp, unsigned char* key) {
+    for (size_t i = 1; i < n; i++) {
+        unsigned char* p = arr + i * size;
+        if (SORT_CMP(cmp, p - size, p) <= 0) continue;
+        memcpy(key, p, size);
+        size_t j = i - 1;
+        while (j > 0 && SORT_CMP(cmp, arr + (j - 1) * size, key) > 0) j--;
+        memmove(arr + (j + 1) * size, arr + j * size, (i - j) * size);
+        memcpy(arr + j * size, key, size);
+        SORT_STATS_MOVES(i - j + 2);
+    }
+}
+
+static void sort_segmentGenericRun(const sort_segment_job* job, size_t first, size_t last) {
+    unsigned char key[job->size];
+    for (size_t i = first; i < last; i++) {
+        unsigned char* a = job->base + sort_segmentStart(job, i) * job->size;
+        size_t n = sort_segmentLen(job, i);
+        if (n <= SORT_SEGMENT_MAX) sort_segmentInsertion(a, n, job->size, job->cmp, key);
+        else introSort(a, n, job->size, job->cmp);
+    }
+}
+
+#ifdef SORT_HAS_THREADS
+//arg: first segment, end segment
+static void sort_segmentTask(sort_pool* pool, size_t worker, const sort_task* task) {
+    (void)pool; (void)worker;
+    const sort_segment_job* job = (const sort_segment_job*)task->job;
+    job->run(job, task->arg[0], task->arg[1]);
+}
+#endif
+
+//Runs job over segments [0, count), split across threads when it is large
+static void sort_segmentsRun(sort_segment_job* job, size_t count, size_t total, size_t nthreads) {
+#ifdef SORT_HAS_THREADS
+    if (nthreads == 0) nthreads = sortHardwareThreads();
+    sort_pool pool;
+    if (nthreads > 1 && count > 1 && total >= 2 * SORT_PARALLEL_GRAIN && sortPoolCreate(&pool, nthreads)) {
+        size_t share = total / (nthreads * 4);
+        if (share < SORT_PARALLEL_GRAIN) share = SORT_PARALLEL_GRAIN;
+        sort_task t;
+        t.fn = sort_segmentTask;
+        t.job = job;
+        //Cut after the segment where the running element count reaches a share
+        size_t first = 0, acc = 0;
+        for (size_t i = 0; i < count; i++) {
+            acc += sort_segmentLen(job, i);
+            if (acc >= share || i + 1 == count) {
+                t.arg[0] = first;
+                t.arg[1] = i + 1;
+                sortPoolSpawn(&pool, 0, &t);
+                first = i + 1;
+                acc = 0;
+            }
+        }
+        sortPoolRun(&pool, 0, true);
+        sortPoolDestroy(&pool);
+        return;
+    }
+#else
+    (void)total;
+    (void)nthreads;
+#endif
+    job->run(job, 0, count);
+}
+
+void sortSegments(void* base, const size_t* offsets, size_t count, size_t size, compare_func_t cmp, size_t nthreads) {
+    assert(base != NULL && "Array cannot be NULL");
+    assert((offsets != NULL || count == 0) && "Offsets cannot be NULL");
+    assert(cmp != NULL && "Comparison function cannot be NULL");
+    size_t total = count ? offsets[count] - offsets[0] : 0;
+    SORT_CALL_BEGIN("sortSegments", total);
+    sort_segment_job job = { (unsigned char*)base, offsets, 0, 0, size, cmp, sort_segmentGenericRun };
+    sort_segmentsRun(&job, count, total, nthreads);
+    SORT_CALL_END();
+}
+
+void sortSegmentsStrided(void* base, size_t count, size_t len, size_t stride, size_t size, compare_func_t cmp, size_t nthreads) {
+    assert(base != NULL && "Array cannot be NULL");
+    assert((count <= 1 || len <= stride) && "Segments cannot overlap");
+    assert(cmp != NULL && "Comparison function cannot be NULL");
+    SORT_CALL_BEGIN("sortSegmentsStrided", count * len);
+    sort_segment_job job = { (unsigned char*)base, NULL, len, stride, size, cmp, sort_segmentGenericRun };
+    sort_segmentsRun(&job, count, count * len, nthreads);
+    SORT_CALL_END();
+}
+
+//SORT_DEFINE_SEGMENT_SORTS(Name, T, LESS) generates sortSegments##Name and
+//sortSegmentsStrided##Name on top of quickSort##Name. The _EX form also takes
+//the KERNEL of SORT_DEFINE_TYPED_SORTS_EX, which then sorts the segments
+//longer than SORT_SEGMENT_NET (the AVX2 kernels finish them with one vector
+//network).
+#define SORT_DEFINE_SEGMENT_SORTS(Name, T, LESS) SORT_DEFINE_SEGMENT_SORTS_EX(Name, T, LESS, SORT_NO_KERNEL)
+#define SORT_DEFINE_SEGMENT_SORTS_EX(Name, T, LESS, KERNEL) \
+static void sort_seg_##Name##_net(T* a, size_t n) { \
+    for (size_t k = sort_segment_net_start[n]; k < sort_segment_net_start[n + 1]; k++) { \
+        T* x = a + sort_segment_net[k][0]; \
+        T* y = a + sort_segment_net[k][1]; \
+        T u = *x, v = *y; \
+        *x = LESS(v, u) ? v : u; \
+        *y = LESS(v, u) ? u : v; \
+    } \
+} \
+/* The same network over two segments of length n, interleaved */ \
+static void sort_seg_##Name##_net2(T* a, T* b, size_t n) { \
+    for (size_t k = sort_segment_net_start[n]; k < sort_segment_net_start[n + 1]; k++) { \
+        size_t i = sort_segment_net[k][0], j = sort_segment_net[k][1]; \
+        T u = a[i], v = a[j], p = b[i], q = b[j]; \
+        a[i] = LESS(v, u) ? v : u; \
+        b[i] = LESS(q, p) ? q : p; \
+        a[j] = LESS(v, u) ? u : v; \
+        b[j] = LESS(q, p) ? p : q; \
+    } \
+} \
+static void sort_seg_##Name##_merge(const T* a, size_t n1, const T* b, size_t n2, T* out) { \
+    size_t i = 0, j = 0; \
+    while (i < n1 && j < n2) { \
+        T x = a[i], y = b[j]; \
+        bool take_b = LESS(y, x); \
+        *out++ = take_b ? y : x; \
+        i += !take_b; \
+        j += take_b; \
+    } \
+    while (i < n1) *out++ = a[i++]; \
+    while (j < n2) *out++ = b[j++]; \
+} \
+/* Networks on blocks of SORT_SEGMENT_NET, then merge passes through tmp */ \
+static void sort_seg_##Name##_blocks(T* a, size_t n) { \
+    T tmp[SORT_SEGMENT_MAX]; \
+    for (size_t lo = 0; lo < n; lo += SORT_SEGMENT_NET) { \
+        sort_seg_##Name##_net(a + lo, n - lo < SORT_SEGMENT_NET ? n - lo : SORT_SEGMENT_NET); \
+    } \
+    T* src = a; \
+    T* dst = tmp; \
+    for (size_t w = SORT_SEGMENT_NET; w < n; w *= 2) { \
+        for (size_t lo = 0; lo < n; lo += 2 * w) { \
+            size_t n1 = n - lo < w ? n - lo : w; \
+            size_t n2 = n - lo - n1 < w ? n - lo - n1 : w; \
+            sort_seg_##Name##_merge(src + lo, n1, src + lo + n1, n2, dst + lo); \
+        } \
+        T* t = src; \
+        src = dst; \
+        dst = t; \
+    } \
+    if (src != a) memcpy(a, src, n * sizeof(T)); \
+} \
+static void sort_seg_##Name##_run(const sort_segment_job* job, size_t first, size_t last) { \
+    T* base = (T*)job->base; \
+    for (size_t i = first; i < last; i++) { \
+        T* a = base + sort_segmentStart(job, i); \
+        size_t n = sort_segmentLen(job, i); \
+        if (n <= SORT_SEGMENT_NET && i + 1 < last && sort_segmentLen(job, i + 1) == n) { \
+            sort_seg_##Name##_net2(a, base + sort_segmentStart(job, i + 1), n); \
+            i++; \
+        } else if (n <= SORT_SEGMENT_NET) { \
+            sort_seg_##Name##_net(a, n); \
+        } else if (!KERNEL(a, n)) { \
+            if (n <= SORT_SEGMENT_MAX) sort_seg_##Name##_blocks(a, n); \
+            else quickSort##Name(a, n); \
+        } \
+    } \
+} \
+void sortSegments##Name(T* base, const size_t* offsets, size_t count, size_t nthreads) { \
+    assert(base != NULL && "Array cannot be NULL"); \
+    assert((offsets != NULL || count == 0) && "Offsets cannot be NULL"); \
+    size_t total = count ? offsets[count] - offsets[0] : 0; \
+    SORT_CALL_BEGIN("sortSegments" #Name, total); \
+    sort_segment_job job = { (unsigned char*)base, offsets, 0, 0, sizeof(T), NULL, sort_seg_##Name##_run }; \
+    sort_segmentsRun(&job, count, total, nthreads); \
+    SORT_CALL_END(); \
+} \
+void sortSegmentsStrided##Name(T* base, size_t count, size_t len, size_t stride, size_t nthreads) { \
+    assert(base != NULL && "Array cannot be NULL"); \
+    assert((count <= 1 || len <= stride) && "Segments cannot overlap"); \
+    SORT_CALL_BEGIN("sortSegmentsStrided" #Name, count * len); \
+    sort_segment_job job = { (unsigned char*)base, NULL, len, stride, sizeof(T), NULL, sort_seg_##Name##_run }; \
+    sort_segmentsRun(&job, count, count * len, nthreads); \
+    SORT_CALL_END(); \
+}
+
+SORT_DEFINE_SEGMENT_SORTS_EX(Int, int, SORT_LESS, SORT_KERNEL_INT)
+SORT_DEFINE_SEGMENT_SORTS_EX(Int64, int64_t, SORT_LESS, SORT_KERNEL_INT64)
+SORT_DEFINE_SEGMENT_SORTS(UInt32, uint32_t, SORT_LESS)
+SORT_DEFINE_SEGMENT_SORTS_EX(Float, float, SORT_LESS, SORT_KERNEL_FLOAT)
+SORT_DEFINE_SEGMENT_SORTS(Double, double, SORT_LESS)
+
+//29. K-Way Merge
+//Merges k sorted spans, such as per-shard results, into one sorted sequence
+//with the loser tree of the external sort: O(n log k) comparisons, and each
+//element is read in place and copied once, to the output.
+//  sort_merge_t       - pull iterator: sortMergeNext returns a pointer to the
+//                       next element inside its span, sortMergeRead copies
+//                       up to max of them into a caller buffer
+//  mergeSortedSpans*  - one-shot merge of the first max_out elements; the
+//                       typed variants compare values inline, without
+//                       compare_func_t
+//Ties go to the lower span index, so the merge is stable across spans.
+//sortMergeRead gallops like timSort: once one span has won SORT_MIN_GALLOP
+//times in a row, each step copies the winner's whole run below the runner-up
+//(found by exponential search) until a run comes out shorter than that, so
+//spans that barely interleave cost O(log n) comparisons per run.
+typedef struct {
+    const void* base;
+    size_t num;
+} sort_span_t;
+
+typedef struct {
+    sort_loser_tree lt;
+    const unsigned char** ends; // one past the last element of each span
+    size_t size;
+    size_t streak; // consecutive wins of one span; galloping from SORT_MIN_GALLOP
+} sort_merge_t;
+
+//Prepares m to merge spans[0, k); the spans array itself may be released
+//afterwards, the elements may not. Returns false if the k-entry tree cannot
+//be allocated from the active sort context.
+bool sortMergeInit(sort_merge_t* m, const sort_span_t* spans, size_t k, size_t size, compare_func_t cmp) {
+    assert(m != NULL && "Merge state cannot be NULL");
+    assert((spans != NULL || k == 0) && "Spans cannot be NULL");
+    assert(cmp != NULL && "Comparison function cannot be NULL");
+    m->size = size;
+    m->streak = 0;
+    m->lt.k = k;
+    m->lt.cmp = cmp;
+    m->lt.tree = NULL;
+    if (k == 0) return true;
+    unsigned char* raw = (unsigned char*)SORT_MALLOC(k * (sizeof(size_t) + 2 * sizeof(unsigned char*)));
+    if (!raw) {
+        sort_fail(SORT_ERROR_NO_MEMORY);
+        m->lt.k = 0;
+        return false;
+    }
+    m->lt.tree = (size_t*)raw;
+    m->lt.heads = (const unsigned char**)(m->lt.tree + k);
+    m->ends = m->lt.heads + k;
+    for (size_t i = 0; i < k; i++) {
+        const unsigned char* p = (const unsigned char*)spans[i].base;
+        m->lt.heads[i] = spans[i].num ? p : NULL;
+        m->ends[i] = spans[i].num ? p + spans[i].num * size : NULL;
+    }
+    sort_loserInit(&m->lt);
+    return true;
+}
+
+//Next element in merged order, or NULL once every span is exhausted
+const void* sortMergeNext(sort_merge_t* m) {
+    if (m->lt.k == 0) return NULL;
+    size_t w = m->lt.tree[0];
+    const unsigned char* p = m->lt.heads[w];
+    if (!p) return NULL;
+    m->lt.heads[w] = p + m->size < m->ends[w] ? p + m->size : NULL;
+    sort_loserReplay(&m->lt);
+    return p;
+}
+
+//Elements at the head of the winning span w that still precede the runner-up,
+//which is the best of the losers on w's path; at least 1
+static size_t sort_mergeRun(const sort_merge_t* m, size_t w) {
+    const sort_loser_tree* lt = &m->lt;
+    size_t r = w;
+    for (size_t node = (w + lt->k) / 2; node >= 1; node /= 2) {
+        size_t c = lt->tree[node];
+        if (r == w || sort_loserBeats(lt, c, r)) r = c;
+    }
+    const unsigned char* head = lt->heads[w];
+    size_t avail = (size_t)(m->ends[w] - head) / m->size;
+    if (r == w || lt->heads[r] == NULL) return avail;
+    //Equal elements of a lower span index stay ahead of the runner-up
+    size_t n = w < r ? gallopRight(lt->heads[r], head, avail, 0, m->size, lt->cmp)
+                     : gallopLeft(lt->heads[r], head, avail, 0, m->size, lt->cmp);
+    return n ? n : 1;
+}
+
+//Copies up to max elements in merged order to out; returns how many (fewer
+//only once the spans are exhausted)
+size_t sortMergeRead(sort_merge_t* m, void* out, size_t max) {
+    assert((out != NULL || max == 0) && "Output cannot be NULL");
+    unsigned char* dst = (unsigned char*)out;
+    size_t n = 0;
+    while (n < max && m->lt.k > 0) {
+        size_t w = m->lt.tree[0];
+        const unsigned char* head = m->lt.heads[w];
+        if (!head) break;
+        bool gallop = m->streak >= SORT_MIN_GALLOP && m->lt.k > 1;
+        size_t run = gallop ? sort_mergeRun(m, w) : 1;
+        size_t take = run < max - n ? run : max - n;
+        memcpy(dst + n * m->size, head, take * m->size);
+        SORT_STATS_MOVES(take);
+        n += take;
+        head += take * m->size;
+        m->lt.heads[w] = head < m->ends[w] ? head : NULL;
+        sort_loserReplay(&m->lt);
+        //Keep galloping while runs stay long, whichever span they come from
+        if (gallop) m->streak = run >= SORT_MIN_GALLOP ? m->streak : 0;
+        else m->streak = m->lt.tree[0] == w ? m->streak + 1 : 0;
+    }
+    return n;
+}
+
+void sortMergeFree(sort_merge_t* m) {
+    SORT_FREE(m->lt.tree);
+    m->lt.tree = NULL;
+    m->lt.k = 0;
+}
+
+//Writes the first max_out elements of the merge of spans[0, k) to out and
+//returns how many were written (min(max_out, total)); 0 with
+//SORT_ERROR_NO_MEMORY if the tree cannot be allocated
+size_t mergeSortedSpans(const sort_span_t* spans, size_t k, size_t size, compare_func_t cmp, void* out, size_t max_out) {
+    SORT_CALL_BEGIN("mergeSortedSpans", max_out);
+    sort_merge_t m;
+    size_t n = 0;
+    if (sortMergeInit(&m, spans, k, size, cmp)) {
+        n = sortMergeRead(&m, out, max_out);
+        sortMergeFree(&m);
+    }
+    SORT_CALL_END();
+    return n;
+}
+
+//SORT_DEFINE_KWAY_MERGE(Name, T, LESS) generates mergeSortedSpans##Name. The
+//tree keeps each span's current value in cur, exhausted spans lose every
+//match, and replays pick the winner with selects rather than branches.
+#define SORT_DEFINE_KWAY_MERGE(Name, T, LESS) \
+static bool sort_kmerge_##Name##_beats(const T* cur, const unsigned char* done, size_t a, size_t b) { \
+    T x = cur[a], y = cur[b]; \
+    return (done[a] == 0) & (done[b] | LESS(x, y) | (!LESS(y, x) & (a < b))); \
+} \
+static size_t sort_kmerge_##Name##_build(size_t* tree, const T* cur, const unsigned char* done, size_t k, size_t node) { \
+    if (node >= k) return node - k; \
+    size_t a = sort_kmerge_##Name##_build(tree, cur, done, k, 2 * node); \
+    size_t b = sort_kmerge_##Name##_build(tree, cur, done, k, 2 * node + 1); \
+    bool a_wins = sort_kmerge_##Name##_beats(cur, done, a, b); \
+    tree[node] = a_wins ? b : a; \
+    return a_wins ? a : b; \
+} \
+size_t mergeSortedSpans##Name(const sort_span_t* spans, size_t k, T* out, size_t max_out) { \
+    assert((spans != NULL || k == 0) && "Spans cannot be NULL"); \
+    assert((out != NULL || max_out == 0) && "Output cannot be NULL"); \
+    SORT_CALL_BEGIN("mergeSortedSpans" #Name, max_out); \
+    size_t total = 0, n = 0; \
+    for (size_t i = 0; i < k; i++) total += spans[i].num; \
+    size_t want = total < max_out ? total : max_out; \
+    if (k <= 1) { \
+        if (want) memcpy(out, spans[0].base, want * sizeof(T)); \
+        SORT_CALL_END(); \
+        return want; \
+    } \
+    if (k == 2) { \
+        /* Branch-free two-way merge; ties take span 0 */ \
+        const T* a = (const T*)spans[0].base; \
+        const T* b = (const T*)spans[1].base; \
+        const T* a_end = a + spans[0].num; \
+        const T* b_end = b + spans[1].num; \
+        while (n < want && a < a_end && b < b_end) { \
+            T x = *a, y = *b; \
+            bool take_b = LESS(y, x); \
+            out[n++] = take_b ? y : x; \
+            a += !take_b; \
+            b += take_b; \
+        } \
+        while (n < want && a < a_end) out[n++] = *a++; \
+        while (n < want && b < b_end) out[n++] = *b++; \
+        SORT_STATS_MOVES(n); \
+        SORT_CALL_END(); \
+        return n; \
+    } \
+    /* tree, pos and end, then cur and done */ \
+    size_t* tree = (size_t*)SORT_MALLOC(k * (sizeof(size_t) + 2 * sizeof(const T*) + sizeof(T) + 1)); \
+    if (!tree) { \
+        sort_fail(SORT_ERROR_NO_MEMORY); \
+        SORT_CALL_END(); \
+        return 0; \
+    } \
+    const T** pos = (const T**)(tree + k); \
+    const T** end = pos + k; \
+    T* cur = (T*)(end + k); \
+    unsigned char* done = (unsigned char*)(cur + k); \
+    for (size_t i = 0; i < k; i++) { \
+        pos[i] = (const T*)spans[i].base; \
+        end[i] = pos[i] + spans[i].num; \
+        done[i] = spans[i].num == 0; \
+        cur[i] = spans[i].num ? *pos[i] : (T)0; \
+    } \
+    tree[0] = sort_kmerge_##Name##_build(tree, cur, done, k, 1); \
+    size_t streak = 0; \
+    while (n < want) { \
+        size_t w = tree[0]; \
+        bool gallop = streak >= SORT_MIN_GALLOP; \
+        size_t run = 1; \
+        if (gallop) { \
+            /* Take w's run up to the runner-up, the best loser on w's path */ \
+            size_t r = tree[(w + k) / 2]; \
+            for (size_t node = (w + k) / 4; node >= 1; node /= 2) { \
+                if (sort_kmerge_##Name##_beats(cur, done, tree[node], r)) r = tree[node]; \
+            } \
+            const T* p = pos[w] + 1; \
+            if (done[r]) { \
+                p = end[w]; \
+            } else { \
+                T bound = cur[r]; \
+                bool tie = w < r; \
+                while (p < end[w] && (LESS(*p, bound) || (tie && !LESS(bound, *p)))) p++; \
+            } \
+            run = (size_t)(p - pos[w]); \
+            if (run > want - n) run = want - n; \
+            memcpy(out + n, pos[w], run * sizeof(T)); \
+        } else { \
+            out[n] = cur[w]; \
+        } \
+        n += run; \
+        pos[w] += run; \
+        if (pos[w] == end[w]) done[w] = 1; \
+        else cur[w] = *pos[w]; \
+        size_t x = w; \
+        for (size_t node = (x + k) / 2; node >= 1; node /= 2) { \
+            size_t c = tree[node]; \
+            bool swap = sort_kmerge_##Name##_beats(cur, done, c, x); \
+            tree[node] = swap ? x : c; \
+            x = swap ? c : x; \
+        } \
+        tree[0] = x; \
+        if (gallop) streak = run >= SORT_MIN_GALLOP ? streak : 0; \
+        else streak = x == w ? streak + 1 : 0; \
+    } \
+    SORT_STATS_MOVES(n); \
+    SORT_FREE(tree); \
+    SORT_CALL_END(); \
+    return n; \
+}
+
+SORT_DEFINE_KWAY_MERGE(Int, int, SORT_LESS)
+SORT_DEFINE_KWAY_MERGE(Int64, int64_t, SORT_LESS)
+SORT_DEFINE_KWAY_MERGE(UInt32, uint32_t, SORT_LESS)
+SORT_DEFINE_KWAY_MERGE(Float, float, SORT_LESS)
+SORT_DEFINE_KWAY_MERGE(Double, double, SORT_LESS)
+
+//Sort dispatch
+//Generic sorts by identifier, for callers that pick the algorithm at run time
+typedef enum {
+    SORT_ALGO_BUBBLE,
+    SORT_ALGO_INSERTION,
+    SORT_ALGO_SELECTION,
+    SORT_ALGO_MERGE,
+    SORT_ALGO_QUICK,
+    SORT_ALGO_HEAP,
+    SORT_ALGO_SHELL,
+    SORT_ALGO_COCKTAIL_SHAKER,
+    SORT_ALGO_COMB,
+    SORT_ALGO_GNOME,
+    SORT_ALGO_ODD_EVEN,
+    SORT_ALGO_BITONIC,
+    SORT_ALGO_CYCLE,
+    SORT_ALGO_INTRO,
+    SORT_ALGO_TIM,
+    SORT_ALGO_PARALLEL,
+    SORT_ALGO_PARALLEL_MERGE,
+    SORT_ALGO_INDIRECT,
+    SORT_ALGO_BLOCK_MERGE,
+    //Typed engines, reported by sortChoose; sortWithContext rejects them
+    SORT_ALGO_PIGEONHOLE,
+    SORT_ALGO_RADIX,
+    SORT_ALGO_PARALLEL_RADIX
+} sort_algorithm_t;
+
+//Arena bytes that let sortWithContext(ctx, algo, ...) run without any other
+//allocation on the calling thread (0 for in-place algorithms)
+size_t sortWorkspaceSize(sort_algorithm_t algo, size_t num, size_t size) {
+    switch (algo) {
+    case SORT_ALGO_MERGE:
+    case SORT_ALGO_TIM:
+        return num >= SORT_MIN_MERGE ? SORT_ARENA_BLOCK(timSortBufferSize(num, size)) : 0;
+    case SORT_ALGO_PARALLEL_MERGE:
+        //The merge buffer plus the run buffer of a chunk sorted on this thread
+        return num >= SORT_MIN_MERGE ? SORT_ARENA_BLOCK(num * size) + SORT_ARENA_BLOCK(timSortBufferSize(num, size)) : 0;
+    case SORT_ALGO_INDIRECT:
+        return num > 1 ? SORT_ARENA_BLOCK(num * sizeof(size_t)) : 0;
+    case SORT_ALGO_BLOCK_MERGE:
+        return num >= 2 * SORT_BLOCK_MERGE_RUN ? SORT_ARENA_BLOCK(blockMergeSortBufferSize(num, size)) : 0;
+    default:
+        return 0;
+    }
+}
+
+//True if algo keeps equal elements in their input order. The quadratic sorts
+//that only move neighbours past each other are stable; selectionSort swaps
+//across the array and is not. The typed engines sort bare keys, and
+//radix and pigeonhole report the stability of their pair variants.
+bool sortIsStable(sort_algorithm_t algo) {
+    switch (algo) {
+    case SORT_ALGO_BUBBLE:
+    case SORT_ALGO_INSERTION:
+    case SORT_ALGO_MERGE:
+    case SORT_ALGO_COCKTAIL_SHAKER:
+    case SORT_ALGO_GNOME:
+    case SORT_ALGO_ODD_EVEN:
+    case SORT_ALGO_TIM:
+    case SORT_ALGO_PARALLEL_MERGE:
+    case SORT_ALGO_INDIRECT:
+    case SORT_ALGO_BLOCK_MERGE:
+    case SORT_ALGO_PIGEONHOLE:
+    case SORT_ALGO_RADIX:
+        return true;
+    default:
+        return false;
+    }
+}
+
+//Runs one sort with ctx active on this thread and returns its status;
+//parallel algorithms use every hardware thread
+sort_status_t sortWithContext(sort_context_t* ctx, sort_algorithm_t algo, void* base, size_t num, size_t size, compare_func_t cmp) {
+    sort_context_t* prev = sortUseContext(ctx);
+    bool known = true;
+    switch (algo) {
+    case SORT_ALGO_BUBBLE: bubbleSort(base, num, size, cmp); break;
+    case SORT_ALGO_INSERTION: insertionSort(base, num, size, cmp); break;
+    case SORT_ALGO_SELECTION: selectionSort(base, num, size, cmp); break;
+    case SORT_ALGO_MERGE: mergeSort(base, num, size, cmp); break;
+    case SORT_ALGO_QUICK: quickSort(base, num, size, cmp); break;
+    case SORT_ALGO_HEAP: heapSort(base, num, size, cmp); break;
+    case SORT_ALGO_SHELL: shellSort(base, num, size, cmp); break;
+    case SORT_ALGO_COCKTAIL_SHAKER: cocktailShakerSort(base, num, size, cmp); break;
+    case SORT_ALGO_COMB: combSort(base, num, size, cmp); break;
+    case SORT_ALGO_GNOME: gnomeSort(base, num, size, cmp); break;
+    case SORT_ALGO_ODD_EVEN: oddEvenSort(base, num, size, cmp); break;
+    case SORT_ALGO_BITONIC: bitonicSort(base, num, size, cmp); break;
+    case SORT_ALGO_CYCLE: cycleSort(base, num, size, cmp); break;
+    case SORT_ALGO_INTRO: introSort(base, num, size, cmp); break;
+    case SORT_ALGO_TIM: timSort(base, num, size, cmp); break;
+    case SORT_ALGO_PARALLEL: parallelSort(base, num, size, cmp, 0); break;
+    case SORT_ALGO_PARALLEL_MERGE: parallelMergeSort(base, num, size, cmp, 0); break;
+    case SORT_ALGO_INDIRECT: indirectSort(base, num, size, cmp, NULL); break;
+    case SORT_ALGO_BLOCK_MERGE: blockMergeSort(base, num, size, cmp); break;
+    default: known = false; break;
+    }
+    sortUseContext(prev);
+    if (!known) sort_last_status = SORT_ERROR_INVALID;
+    return sort_last_status;
+}
+
+//30. Automatic Selection
+//autoSort inspects the input and runs the engine that suits it. For numeric
+//key types, in order:
+//  - n <= SORT_AUTO_SMALL                         insertionSort##Name
+//  - already ascending (sample, then full pass)   mergeSort##Name, O(n)
+//  - int keys with max - min <= n (full pass)     pigeonholeSort
+//    or many duplicates (hashed counts)
+//  - AVX2 kernel (int, float) or many duplicates  quickSort##Name
+//  - mostly ordered                               mergeSort##Name ascending
+//                                                 (in-order halves are not
+//                                                 merged), quickSort##Name
+//                                                 descending
+//  - n >= SORT_AUTO_RADIX_MIN                     radixSort##Name (parallel
+//                                                 from SORT_AUTO_PARALLEL_MIN)
+//  - otherwise                                    quickSort##Name
+//Generic elements (cmp only) go to insertionSort when small, timSort when
+//mostly ordered, indirectSort when wide, else introSort or parallelSort.
+//Order, duplicates and range are estimated from SORT_AUTO_SAMPLE evenly
+//spaced positions; a full O(n) pass only confirms sorted or narrow samples.
+//The default thresholds come from benchmark_sorting runs on x86-64 and can
+//be overridden before including sort.h. The result is not stable.
+#ifndef SORT_AUTO_SMALL
+#define SORT_AUTO_SMALL 32
+#endif
+#ifndef SORT_AUTO_SAMPLE
+#define SORT_AUTO_SAMPLE 64
+#endif
+#if SORT_AUTO_SAMPLE < 1
+#error "SORT_AUTO_SAMPLE must be at least 1"
+#endif
+#ifndef SORT_AUTO_RUN_RATIO
+#define SORT_AUTO_RUN_RATIO 0.9 // sampled pairs in order for timSort
+#endif
+#ifndef SORT_AUTO_RUN_MAX_SIZE
+#define SORT_AUTO_RUN_MAX_SIZE 64 // wider elements copy too much in merges
+#endif
+#ifndef SORT_AUTO_DUPLICATE_RATIO
+#define SORT_AUTO_DUPLICATE_RATIO 0.5 // sampled duplicates for three-way quicksort
+#endif
+#ifndef SORT_AUTO_INDIRECT_SIZE
+#define SORT_AUTO_INDIRECT_SIZE 512
+#endif
+#ifndef SORT_AUTO_RADIX_MIN
+#define SORT_AUTO_RADIX_MIN 4096
+#endif
+#ifndef SORT_AUTO_PARALLEL_MIN
+#define SORT_AUTO_PARALLEL_MIN (1 << 20)
+#endif
+
+typedef enum {
+    SORT_KEY_GENERIC, // only cmp is known
+    SORT_KEY_INT,
+    SORT_KEY_INT64,
+    SORT_KEY_UINT32,
+    SORT_KEY_FLOAT,  // no NaN
+    SORT_KEY_DOUBLE  // no NaN
+} sort_key_type_t;
+
+typedef struct {
+    sort_algorithm_t algorithm; // engine family
+    const char* name;           // function that sorts, e.g. "radixSortInt64"
+    sort_key_type_t key_type;
+    size_t num;
+    size_t size;
+    double sorted_ratio;        // sampled adjacent pairs in order, either direction
+    bool descending;            // ... and that direction is descending
+    double duplicate_ratio;     // sampled elements equal to their sorted neighbour
+    uint64_t key_range;         // max - min of integer keys (sampled, or exact
+                                // once the full pass ran); 0 otherwise
+} sort_decision_t;
+
+static int sort_compareInt64(const void* a, const void* b) {
+    int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
+static int sort_compareUInt32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+static int sort_compareFloat(const void* a, const void* b) {
+    float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+static int sort_compareDouble(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static compare_func_t sort_keyCompare(sort_key_type_t key_type, compare_func_t cmp) {
+    switch (key_type) {
+    case SORT_KEY_INT: return compare_ints;
+    case SORT_KEY_INT64: return sort_compareInt64;
+    case SORT_KEY_UINT32: return sort_compareUInt32;
+    case SORT_KEY_FLOAT: return sort_compareFloat;
+    case SORT_KEY_DOUBLE: return sort_compareDouble;
+    default: return cmp;
+    }
+}
+
+static size_t sort_keySize(sort_key_type_t key_type) {
+    switch (key_type) {
+    case SORT_KEY_INT: return sizeof(int);
+    case SORT_KEY_INT64: return sizeof(int64_t);
+    case SORT_KEY_UINT32: return sizeof(uint32_t);
+    case SORT_KEY_FLOAT: return sizeof(float);
+    case SORT_KEY_DOUBLE: return sizeof(double);
+    default: return 0;
+    }
+}
+
+//Integer key as int64 (all integer key types fit)
+static int64_t sort_keyInteger(const unsigned char* p, sort_key_type_t key_type) {
+    if (key_type == SORT_KEY_INT) { int v; memcpy(&v, p, sizeof(v)); return v; }
+    if (key_type == SORT_KEY_UINT32) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+    int64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+//True when quickSort##Name for this key type runs an AVX2 kernel
+static bool sort_simdActive(sort_key_type_t key_type) {
+#ifdef SORT_HAS_AVX2
+    if (key_type == SORT_KEY_INT || key_type == SORT_KEY_FLOAT) return __builtin_cpu_supports("avx2");
+#else
+    (void)key_type;
+#endif
+    return false;
+}
+
+static bool sort_autoIsSorted(const unsigned char* arr, size_t num, sort_key_type_t key_type) {
+#define SORT_AUTO_SORTED(T) { \
+        const T* a = (const T*)(const void*)arr; \
+        for (size_t i = 1; i < num; i++) if (a[i] < a[i - 1]) return false; \
+        return true; \
+    }
+    switch (key_type) {
+    case SORT_KEY_INT: SORT_AUTO_SORTED(int)
+    case SORT_KEY_INT64: SORT_AUTO_SORTED(int64_t)
+    case SORT_KEY_UINT32: SORT_AUTO_SORTED(uint32_t)
+    case SORT_KEY_FLOAT: SORT_AUTO_SORTED(float)
+    case SORT_KEY_DOUBLE: SORT_AUTO_SORTED(double)
+    default: return false;
+    }
+#undef SORT_AUTO_SORTED
+}
+
+static bool sort_autoParallel(size_t num) {
+#ifdef SORT_HAS_THREADS
+    return num >= SORT_AUTO_PARALLEL_MIN && sortHardwareThreads() > 1;
+#else
+    (void)num;
+    return false;
+#endif
+}
+
+static void sort_decide(sort_decision_t* d, sort_algorithm_t algorithm, const char* name) {
+    d->algorithm = algorithm;
+    d->name = name;
+}
+
+//Chooses the engine autoSort would run, without sorting. cmp may be NULL for
+//numeric key types, which order ascending.
+sort_decision_t sortChoose(const void* base, size_t num, size_t size, compare_func_t cmp, sort_key_type_t key_type) {
+    assert(base != NULL && "Array cannot be NULL");
+    assert((key_type != SORT_KEY_GENERIC || cmp != NULL) && "Generic keys need a comparison function");
+    assert((key_type == SORT_KEY_GENERIC || size == sort_keySize(key_type)) && "Element size does not match the key type");
+    sort_decision_t d;
+    memset(&d, 0, sizeof(d));
+    d.key_type = key_type;
+    d.num = num;
+    d.size = size;
+    const unsigned char* arr = (const unsigned char*)base;
+    compare_func_t order = sort_keyCompare(key_type, cmp);
+    static const char* const quick_names[] = {"introSort", "quickSortInt", "quickSortInt64", "quickSortUInt32", "quickSortFloat", "quickSortDouble"};
+    static const char* const insertion_names[] = {"insertionSort", "insertionSortInt", "insertionSortInt64", "insertionSortUInt32", "insertionSortFloat", "insertionSortDouble"};
+    static const char* const merge_names[] = {"timSort", "mergeSortInt", "mergeSortInt64", "mergeSortUInt32", "mergeSortFloat", "mergeSortDouble"};
+    static const char* const radix_names[] = {"", "radixSortInt", "radixSortInt64", "radixSortUInt32", "radixSortFloat", "radixSortDouble"};
+    static const char* const parallel_radix_names[] = {"", "parallelRadixSortInt", "parallelRadixSortInt64", "parallelRadixSortUInt32", "parallelRadixSortFloat", "parallelRadixSortDouble"};
+    //Sampling needs at least one adjacent pair, whatever SORT_AUTO_SMALL is
+    if (num < 2 || num <= SORT_AUTO_SMALL) {
+        sort_decide(&d, SORT_ALGO_INSERTION, insertion_names[key_type]);
+        return d;
+    }
+
+    //Presortedness from adjacent pairs, duplicates and range from single samples
+    size_t samples = SORT_AUTO_SAMPLE < num - 1 ? SORT_AUTO_SAMPLE : num - 1;
+    size_t ascending = 0, descending = 0;
+    const unsigned char* picked[SORT_AUTO_SAMPLE];
+    for (size_t s = 0; s < samples; s++) {
+        size_t i = s * (num - 1) / samples;
+        int c = SORT_CMP(order, arr + i * size, arr + (i + 1) * size);
+        if (c <= 0) ascending++;
+        if (c >= 0) descending++;
+        picked[s] = arr + i * size;
+    }
+    d.descending = descending > ascending;
+    d.sorted_ratio = (double)(d.descending ? descending : ascending) / (double)samples;
+    for (size_t s = 1; s < samples; s++) {
+        const unsigned char* v = picked[s];
+        size_t j = s;
+        while (j > 0 && SORT_CMP(order, v, picked[j - 1]) < 0) {
+            picked[j] = picked[j - 1];
+            j--;
+        }
+        picked[j] = v;
+    }
+    size_t duplicates = 0;
+    for (size_t s = 1; s < samples; s++) {
+        if (SORT_CMP(order, picked[s - 1], picked[s]) == 0) duplicates++;
+    }
+    d.duplicate_ratio = (double)duplicates / (double)samples;
+    bool integer = key_type == SORT_KEY_INT || key_type == SORT_KEY_INT64 || key_type == SORT_KEY_UINT32;
+    if (integer) {
+        d.key_range = (uint64_t)sort_keyInteger(picked[samples - 1], key_type) - (uint64_t)sort_keyInteger(picked[0], key_type);
+    }
+
+    if (key_type == SORT_KEY_GENERIC) {
+        //timSort finds the runs itself, so a sorted sample needs no proof
+        if (d.sorted_ratio == 1.0 || (d.sorted_ratio >= SORT_AUTO_RUN_RATIO && size <= SORT_AUTO_RUN_MAX_SIZE)) sort_decide(&d, SORT_ALGO_TIM, "timSort");
+        else if (size >= SORT_AUTO_INDIRECT_SIZE) sort_decide(&d, SORT_ALGO_INDIRECT, "indirectSort");
+        else if (sort_autoParallel(num)) sort_decide(&d, SORT_ALGO_PARALLEL, "parallelSort");
+        else sort_decide(&d, SORT_ALGO_INTRO, "introSort");
+        return d;
+    }
+    //A sorted sample is confirmed with a full pass: sawtooth input fools it.
+    //A narrow sampled range is confirmed before sizing holes by it.
+    if (d.sorted_ratio == 1.0 && !d.descending && sort_autoIsSorted(arr, num, key_type)) {
+        sort_decide(&d, SORT_ALGO_MERGE, merge_names[key_type]);
+        return d;
+    }
+    if (key_type == SORT_KEY_INT && d.duplicate_ratio >= SORT_AUTO_DUPLICATE_RATIO) {
+        sort_decide(&d, SORT_ALGO_PIGEONHOLE, "pigeonholeSort");
+        return d;
+    }
+    if (key_type == SORT_KEY_INT && d.key_range <= num) {
+        const int* a = (const int*)base;
+        int lo = a[0], hi = a[0];
+        for (size_t i = 1; i < num; i++) {
+            if (a[i] < lo) lo = a[i];
+            if (a[i] > hi) hi = a[i];
+        }
+        d.key_range = (uint64_t)((int64_t)hi - lo);
+        if (d.key_range <= num) {
+            sort_decide(&d, SORT_ALGO_PIGEONHOLE, "pigeonholeSort");
+            return d;
+        }
+    }
+    bool simd = sort_simdActive(key_type);
+    if (simd || d.duplicate_ratio >= SORT_AUTO_DUPLICATE_RATIO) {
+        sort_decide(&d, SORT_ALGO_QUICK, quick_names[key_type]);
+    } else if (d.sorted_ratio >= SORT_AUTO_RUN_RATIO) {
+        //Scalar mergeSort skips merging halves already in order, so long
+        //ascending stretches cost one compare per split; descending runs
+        //suit quickSort's pivots better than radix scatters
+        if (d.descending) sort_decide(&d, SORT_ALGO_QUICK, quick_names[key_type]);
+        else sort_decide(&d, SORT_ALGO_MERGE, merge_names[key_type]);
+    } else if (num >= SORT_AUTO_RADIX_MIN) {
+        if (sort_autoParallel(num)) sort_decide(&d, SORT_ALGO_PARALLEL_RADIX, parallel_radix_names[key_type]);
+        else sort_decide(&d, SORT_ALGO_RADIX, radix_names[key_type]);
+    } else {
+        sort_decide(&d, SORT_ALGO_QUICK, quick_names[key_type]);
+    }
+    return d;
+}
+
+//Sorts with the engine sortChoose picks and returns the decision for logging
+sort_decision_t autoSort(void* base, size_t num, size_t size, compare_func_t cmp, sort_key_type_t key_type) {
+    SORT_CALL_BEGIN("autoSort", num);
+    sort_decision_t d = sortChoose(base, num, size, cmp, key_type);
+    if (num <= 1) { SORT_CALL_END(); return d; }
+    if (key_type == SORT_KEY_GENERIC) {
+        sortWithContext(sort_context_active, d.algorithm, base, num, size, cmp);
+        SORT_CALL_END();
+        return d;
+    }
+#define SORT_AUTO_TYPED(Name, T) \
+    switch (d.algorithm) { \
+    case SORT_ALGO_INSERTION: insertionSort##Name((T*)base, num); break; \
+    case SORT_ALGO_MERGE: mergeSort##Name((T*)base, num); break; \
+    case SORT_ALGO_RADIX: radixSort##Name((T*)base, num); break; \
+    case SORT_ALGO_PARALLEL_RADIX: parallelRadixSort##Name((T*)base, num, 0); break; \
+    default: quickSort##Name((T*)base, num); break; \
+    }
+    switch (key_type) {
+    case SORT_KEY_INT:
+        if (d.algorithm == SORT_ALGO_PIGEONHOLE) pigeonholeSort((int*)base, num);
+        else SORT_AUTO_TYPED(Int, int)
+        break;
+    case SORT_KEY_INT64: SORT_AUTO_TYPED(Int64, int64_t) break;
+    case SORT_KEY_UINT32: SORT_AUTO_TYPED(UInt32, uint32_t) break;
+    case SORT_KEY_FLOAT: SORT_AUTO_TYPED(Float, float) break;
+    case SORT_KEY_DOUBLE: SORT_AUTO_TYPED(Double, double) break;
+    default: break;
+    }
+#undef SORT_AUTO_TYPED
+    SORT_CALL_END();
+    return d;
+}
+
+#ifdef __cplusplus
+//C++ overloads so typed arrays pick the specialized engines by argument type
+inline void insertionSort(int* arr, size_t num) { insertionSortInt(arr, num); }
+inline void insertionSort(int64_t* arr, size_t num) { insertionSortInt64(arr, num); }
+inline void insertionSort(uint32_t* arr, size_t num) { insertionSortUInt32(arr, num); }
+inline void insertionSort(float* arr, size_t num) { insertionSortFloat(arr, num); }
+inline void insertionSort(double* arr, size_t num) { insertionSortDouble(arr, num); }
+inline void heapSort(int* arr, size_t num) { heapSortInt(arr, num); }
+inline void heapSort(int64_t* arr, size_t num) { heapSortInt64(arr, num); }
+inline void heapSort(uint32_t* arr, size_t num) { heapSortUInt32(arr, num); }
+inline void heapSort(float* arr, size_t num) { heapSortFloat(arr, num); }
+inline void heapSort(double* arr, size_t num) { heapSortDouble(arr, num); }
+inline void quickSort(int* arr, size_t num) { quickSortInt(arr, num); }
+inline void quickSort(int64_t* arr, size_t num) { quickSortInt64(arr, num); }
+inline void quickSort(uint32_t* arr, size_t num) { quickSortUInt32(arr, num); }
+inline void quickSort(float* arr, size_t num) { quickSortFloat(arr, num); }
+inline void quickSort(double* arr, size_t num) { quickSortDouble(arr, num); }
+inline void mergeSort(int* arr, size_t num) { mergeSortInt(arr, num); }
+inline void mergeSort(int64_t* arr, size_t num) { mergeSortInt64(arr, num); }
+inline void mergeSort(uint32_t* arr, size_t num) { mergeSortUInt32(arr, num); }
+inline void mergeSort(float* arr, size_t num) { mergeSortFloat(arr, num); }
+inline void mergeSort(double* arr, size_t num) { mergeSortDouble(arr, num); }
+inline void bitonicSort(int* arr, size_t num) { bitonicSortInt(arr, num); }
+inline void bitonicSort(int64_t* arr, size_t num) { bitonicSortInt64(arr, num); }
+inline void bitonicSort(uint32_t* arr, size_t num) { bitonicSortUInt32(arr, num); }
+inline void bitonicSort(float* arr, size_t num) { bitonicSortFloat(arr, num); }
+inline void bitonicSort(double* arr, size_t num) { bitonicSortDouble(arr, num); }
+inline void sortSegments(int* base, const size_t* offsets, size_t count, size_t nthreads) { sortSegmentsInt(base, offsets, count, nthreads); }
+inline void sortSegments(int64_t* base, const size_t* offsets, size_t count, size_t nthreads) { sortSegmentsInt64(base, offsets, count, nthreads); }
+inline void sortSegments(uint32_t* base, const size_t* offsets, size_t count, size_t nthreads) { sortSegmentsUInt32(base, offsets, count, nthreads); }
+inline void sortSegments(float* base, const size_t* offsets, size_t count, size_t nthreads) { sortSegmentsFloat(base, offsets, count, nthreads); }
+inline void sortSegments(double* base, const size_t* offsets, size_t count, size_t nthreads) { sortSegmentsDouble(base, offsets, count, nthreads); }
+inline void sortSegmentsStrided(int* base, size_t count, size_t len, size_t stride, size_t nthreads) { sortSegmentsStridedInt(base, count, len, stride, nthreads); }
+inline void sortSegmentsStrided(int64_t* base, size_t count, size_t len, size_t stride, size_t nthreads) { sortSegmentsStridedInt64(base, count, len, stride, nthreads); }
+inline void sortSegmentsStrided(uint32_t* base, size_t count, size_t len, size_t stride, size_t nthreads) { sortSegmentsStridedUInt32(base, count, len, stride, nthreads); }
+inline void sortSegmentsStrided(float* base, size_t count, size_t len, size_t stride, size_t nthreads) { sortSegmentsStridedFloat(base, count, len, stride, nthreads); }
+inline void sortSegmentsStrided(double* base, size_t count, size_t len, size_t stride, size_t nthreads) { sortSegmentsStridedDouble(base, count, len, stride, nthreads); }
+inline size_t mergeSortedSpans(const sort_span_t* spans, size_t k, int* out, size_t max_out) { return mergeSortedSpansInt(spans, k, out, max_out); }
+inline size_t mergeSortedSpans(const sort_span_t* spans, size_t k, int64_t* out, size_t max_out) { return mergeSortedSpansInt64(spans, k, out, max_out); }
+inline size_t mergeSortedSpans(const sort_span_t* spans, size_t k, uint32_t* out, size_t max_out) { return mergeSortedSpansUInt32(spans, k, out, max_out); }
+inline size_t mergeSortedSpans(const sort_span_t* spans, size_t k, float* out, size_t max_out) { return mergeSortedSpansFloat(spans, k, out, max_out); }
+inline size_t mergeSortedSpans(const sort_span_t* spans, size_t k, double* out, size_t max_out) { return mergeSortedSpansDouble(spans, k, out, max_out); }
+#endif
+
 #endif // SORT_H
\ No newline at end of file
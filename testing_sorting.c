@@ -2,8 +2,71 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <math.h>
 #include "sort.h" 
 
+static void parallelSortAllCores(void* base, size_t num, size_t size, compare_func_t cmp) {
+    parallelSort(base, num, size, cmp, 0);
+}
+
+static void parallelMergeSortAllCores(void* base, size_t num, size_t size, compare_func_t cmp) {
+    parallelMergeSort(base, num, size, cmp, 0);
+}
+
+static void int_key(const void* elem, unsigned char* key) {
+    sortKeyPutI32(key, *(const int*)elem);
+}
+
+static void keySortInts(void* base, size_t num, size_t size, compare_func_t cmp) {
+    (void)cmp;
+    keySort(base, num, size, sizeof(int32_t), int_key);
+}
+
+static void partialSortFirstHalf(void* base, size_t num, size_t size, compare_func_t cmp) {
+    partialSort(base, num, size, cmp, num / 2);
+}
+
+static void mergeSecondHalfAsBatch(void* base, size_t num, size_t size, compare_func_t cmp) {
+    timSort(base, num / 2, size, cmp);
+    mergeSortedBatch(base, num / 2, num - num / 2, size, cmp);
+}
+
+//Appends shrinking batches (4, 3, 2, ...) to an empty run tracker
+static void appendShrinkingBatches(void* base, size_t num, size_t size, compare_func_t cmp) {
+    sort_runs_t runs;
+    sortRunsInit(&runs, base, 0, size, cmp);
+    size_t batch = 4;
+    while (runs.num < num) {
+        sortRunsAppend(&runs, batch < num - runs.num ? batch : num - runs.num);
+        if (batch > 1) batch--;
+    }
+    sortRunsFlush(&runs);
+}
+
+static void indirectSortNoPrefix(void* base, size_t num, size_t size, compare_func_t cmp) {
+    indirectSort(base, num, size, cmp, NULL);
+}
+
+static void sortRowsOfFive(int* arr, size_t num) {
+    sortSegmentsStridedInt(arr, num / 5, 5, 5, 1);
+}
+
+static void mergeSortedHalves(int* arr, size_t num) {
+    int* merged = (int*)malloc(num * sizeof(int));
+    if (!merged) return;
+    quickSortInt(arr, num / 2);
+    quickSortInt(arr + num / 2, num - num / 2);
+    sort_span_t spans[2] = {{arr, num / 2}, {arr + num / 2, num - num / 2}};
+    mergeSortedSpansInt(spans, 2, merged, num);
+    memcpy(arr, merged, num * sizeof(int));
+    free(merged);
+}
+
+static void autoSortInts(int* arr, size_t num) {
+    sort_decision_t decision = autoSort(arr, num, sizeof(int), NULL, SORT_KEY_INT);
+    printf("%-25s: %s\n", "Chosen", decision.name);
+}
+
 void print_array(const char* label, int arr[], size_t n) {
     printf("%-25s: [ ", label);
     for (size_t i = 0; i < n; i++) {
@@ -51,6 +114,85 @@ void test_specialized_sort(const char* algorithm_name, void (*sort_func)(int*, s
     printf("\n");
 }
 
+//Sorts floats that mix -0.0 and +0.0; both must survive the sort
+void test_float_sort(const char* algorithm_name, void (*sort_func)(float*, size_t), const float arr[], size_t n) {
+    float* temp_arr = (float*)malloc(n * sizeof(float));
+    if (!temp_arr) {
+        printf("Memory allocation failed for %s\n", algorithm_name);
+        return;
+    }
+    memcpy(temp_arr, arr, n * sizeof(float));
+
+    printf("--- Testing %s ---\n", algorithm_name);
+    sort_func(temp_arr, n);
+    size_t negative_zeros = 0, expected = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (arr[i] == 0.0f && signbit(arr[i])) expected++;
+        if (temp_arr[i] == 0.0f && signbit(temp_arr[i])) negative_zeros++;
+    }
+    printf("%-25s: [ ", "Sorted");
+    for (size_t i = 0; i < n; i++) printf("%g%s", temp_arr[i], i < n - 1 ? ", " : "");
+    printf(" ]\n");
+    printf("%-25s: %zu of %zu %s\n", "-0.0 kept", negative_zeros, expected, negative_zeros == expected ? "(ok)" : "(WRONG)");
+    free(temp_arr);
+    printf("\n");
+}
+
+static void sortFloatSegment(float* arr, size_t num) {
+    sortSegmentsStridedFloat(arr, 1, num, num, 1);
+}
+
+void test_external_sort(const char* algorithm_name, int arr[], size_t n) {
+    const char* input_path = "sortinc_external_in.bin";
+    const char* output_path = "sortinc_external_out.bin";
+    int* temp_arr = (int*)malloc(n * sizeof(int));
+    FILE* f = fopen(input_path, "wb");
+    if (!temp_arr || !f || fwrite(arr, sizeof(int), n, f) != n) {
+        printf("Setup failed for %s\n", algorithm_name);
+        if (f) fclose(f);
+        free(temp_arr);
+        return;
+    }
+    fclose(f);
+
+    printf("--- Testing %s ---\n", algorithm_name);
+    print_array("Original", arr, n);
+
+    //A tiny budget forces several spilled runs and a real k-way merge
+    if (externalSort(input_path, output_path, NULL, sizeof(int), compare_ints, 4 * sizeof(int)) == 0 &&
+        (f = fopen(output_path, "rb")) != NULL) {
+        size_t got = fread(temp_arr, sizeof(int), n, f);
+        fclose(f);
+        print_array("Sorted", temp_arr, got);
+    } else {
+        printf("%s failed\n", algorithm_name);
+    }
+    remove(input_path);
+    remove(output_path);
+    free(temp_arr);
+    printf("\n");
+}
+
+void test_string_sort(const char* algorithm_name, void (*sort_func)(const char**, size_t, size_t*)) {
+    const char* words[] = {"banana", "apple", "band", "bandana", "app", "cherry", "ban", "apple"};
+    size_t n = sizeof(words) / sizeof(words[0]);
+    size_t lcp[sizeof(words) / sizeof(words[0])];
+
+    printf("--- Testing %s ---\n", algorithm_name);
+    printf("%-25s: [ ", "Original");
+    for (size_t i = 0; i < n; i++) printf("%s%s", words[i], i < n - 1 ? ", " : "");
+    printf(" ]\n");
+
+    sort_func(words, n, lcp);
+
+    printf("%-25s: [ ", "Sorted");
+    for (size_t i = 0; i < n; i++) printf("%s%s", words[i], i < n - 1 ? ", " : "");
+    printf(" ]\n");
+    printf("%-25s: [ ", "LCP");
+    for (size_t i = 0; i < n; i++) printf("%zu%s", lcp[i], i < n - 1 ? ", " : "");
+    printf(" ]\n\n");
+}
+
 int main() {
     int test_data[] = {64, 34, 25, 12, 22, 11, 90, 88, 7, 21};
     size_t n = sizeof(test_data) / sizeof(test_data[0]);
@@ -67,9 +209,23 @@ int main() {
     test_generic_sort("Gnome Sort", (void (*)(void*, size_t, size_t, compare_func_t))gnomeSort, test_data, n);
     test_generic_sort("Odd-Even Sort", (void (*)(void*, size_t, size_t, compare_func_t))oddEvenSort, test_data, n);
     test_generic_sort("Cycle Sort", (void (*)(void*, size_t, size_t, compare_func_t))cycleSort, test_data, n);
+    test_generic_sort("Intro Sort", (void (*)(void*, size_t, size_t, compare_func_t))introSort, test_data, n);
+    test_generic_sort("Tim Sort", (void (*)(void*, size_t, size_t, compare_func_t))timSort, test_data, n);
+    test_generic_sort("Block Merge Sort", (void (*)(void*, size_t, size_t, compare_func_t))blockMergeSort, test_data, n);
+    test_generic_sort("Parallel Sort", parallelSortAllCores, test_data, n);
+    test_generic_sort("Parallel Merge Sort", parallelMergeSortAllCores, test_data, n);
+    test_generic_sort("Indirect Sort", indirectSortNoPrefix, test_data, n);
+    test_generic_sort("Key Sort", keySortInts, test_data, n);
+    test_generic_sort("Partial Sort (first half)", partialSortFirstHalf, test_data, n);
+    test_generic_sort("Merge Sorted Batch", mergeSecondHalfAsBatch, test_data, n);
+    test_generic_sort("Sorted Runs (shrinking batches)", appendShrinkingBatches, test_data, n);
+
+    test_external_sort("External Sort", test_data, n);
+
+    test_generic_sort("Bitonic Sort", (void (*)(void*, size_t, size_t, compare_func_t))bitonicSort, test_data, n);
 
-    int bitonic_data[] = {8, 7, 6, 5, 4, 3, 2, 1};
-    test_generic_sort("Bitonic Sort", (void (*)(void*, size_t, size_t, compare_func_t))bitonicSort, bitonic_data, 8);
+    test_string_sort("Multikey Quick Sort", multikeyQuickSort);
+    test_string_sort("String Sort (MSD radix)", stringSort);
 
     int specialized_data[] = {170, 45, 75, 90, 802, 24, 2, 66};
     size_t specialized_n = sizeof(specialized_data) / sizeof(specialized_data[0]);
@@ -79,5 +235,25 @@ int main() {
     test_specialized_sort("Bucket Sort", bucketSort, specialized_data, specialized_n);
     test_specialized_sort("Pigeonhole Sort", pigeonholeSort, specialized_data, specialized_n);
 
+    int signed_data[] = {-170, 45, -75, 90, 802, -24, 2, 0, 2147483647, -2147483647 - 1};
+    size_t signed_n = sizeof(signed_data) / sizeof(signed_data[0]);
+    test_specialized_sort("Radix Sort (signed)", radixSort, signed_data, signed_n);
+    test_specialized_sort("Counting Sort (signed)", countingSort, signed_data, signed_n);
+    test_specialized_sort("Bucket Sort (signed)", bucketSort, signed_data, signed_n);
+
+    test_specialized_sort("Quick Sort (int)", quickSortInt, test_data, n);
+    test_specialized_sort("Merge Sort (int)", mergeSortInt, test_data, n);
+    test_specialized_sort("Heap Sort (int)", heapSortInt, test_data, n);
+    test_specialized_sort("Insertion Sort (int)", insertionSortInt, test_data, n);
+    test_specialized_sort("Bitonic Sort (int)", bitonicSortInt, test_data, n);
+    test_specialized_sort("Segment Sort (rows of 5)", sortRowsOfFive, test_data, n);
+    test_specialized_sort("K-Way Merge (two halves)", mergeSortedHalves, test_data, n);
+    test_specialized_sort("Auto Sort (int)", autoSortInts, test_data, n);
+
+    float zeros[] = {0.0f, -0.0f, 1.5f, -0.0f, 0.0f, -2.0f, -0.0f, 0.0f, 3.0f, -0.0f, 0.0f, 0.0f, -1.0f, -0.0f, 0.0f, 2.0f, -0.0f, 0.0f};
+    size_t zeros_n = sizeof(zeros) / sizeof(zeros[0]);
+    test_float_sort("Quick Sort (float, +/-0)", quickSortFloat, zeros, zeros_n);
+    test_float_sort("Segment Sort (float, +/-0)", sortFloatSegment, zeros, zeros_n);
+
     return 0;
 }